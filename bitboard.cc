@@ -0,0 +1,143 @@
+#include "bitboard.h"
+
+#include <algorithm>
+
+namespace chess {
+
+namespace {
+
+Bitboard ColumnMask(int min_col, int max_col) {
+  Bitboard mask;
+  for (int row = 0; row < 14; row++) {
+    for (int col = min_col; col <= max_col; col++) {
+      mask.Set(14 * row + col);
+    }
+  }
+  return mask;
+}
+
+// Moves every square of `bb` by (delta_row, delta_col). Squares that would
+// wrap around a board edge are masked off before shifting, and squares that
+// land off the board (including the cut-off corners) are masked off after.
+Bitboard ShiftBy(const Bitboard& bb, int delta_row, int delta_col,
+                 const Bitboard& legal) {
+  Bitboard source = bb
+    & ColumnMask(std::max(0, -delta_col), std::min(13, 13 - delta_col));
+  return source.Shift(14 * delta_row + delta_col) & legal;
+}
+
+BitboardTables* CreateBitboardTables() {
+  auto* tables = new BitboardTables();
+
+  for (int row = 0; row < 14; row++) {
+    for (int col = 0; col < 14; col++) {
+      if (IsLegalSquare(row, col)) {
+        tables->legal.Set(14 * row + col);
+      }
+    }
+  }
+  const Bitboard& legal = tables->legal;
+
+  constexpr int kKnightDeltas[8][2] = {
+    {-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1},
+  };
+  // Forward direction and capture offsets for each color's pawns.
+  constexpr int kPawnCaptureDeltas[4][2][2] = {
+    {{-1, -1}, {-1, 1}},  // RED
+    {{-1, 1}, {1, 1}},    // BLUE
+    {{1, -1}, {1, 1}},    // YELLOW
+    {{-1, -1}, {1, -1}},  // GREEN
+  };
+
+  for (int square = 0; square < kNumSquares; square++) {
+    if (!legal.Test(square)) {
+      continue;
+    }
+    Bitboard bb = Bitboard::FromSquare(square);
+
+    for (const auto& delta : kKnightDeltas) {
+      tables->knight_attacks[square] |= ShiftBy(bb, delta[0], delta[1], legal);
+    }
+    for (int dir = 0; dir < kNumDirections; dir++) {
+      tables->king_attacks[square] |= ShiftBy(
+          bb, kDirectionRow[dir], kDirectionCol[dir], legal);
+    }
+    for (int color = 0; color < 4; color++) {
+      for (const auto& delta : kPawnCaptureDeltas[color]) {
+        tables->pawn_attacks[color][square] |= ShiftBy(
+            bb, delta[0], delta[1], legal);
+        tables->pawn_attackers[color][square] |= ShiftBy(
+            bb, -delta[0], -delta[1], legal);
+      }
+    }
+
+    // Rays stop at the first square that is off the board.
+    for (int dir = 0; dir < kNumDirections; dir++) {
+      Bitboard ray;
+      int length = 0;
+      Bitboard next = ShiftBy(bb, kDirectionRow[dir], kDirectionCol[dir], legal);
+      while (next.Any()) {
+        ray |= next;
+        tables->ray_squares[dir][square][length++] = next.Lsb();
+        next = ShiftBy(next, kDirectionRow[dir], kDirectionCol[dir], legal);
+      }
+      tables->rays[dir][square] = ray;
+      tables->ray_length[dir][square] = length;
+    }
+  }
+
+  for (int from = 0; from < kNumSquares; from++) {
+    for (int to = 0; to < kNumSquares; to++) {
+      tables->direction_to[from][to] = -1;
+    }
+    for (int dir = 0; dir < kNumDirections; dir++) {
+      for (int i = 0; i < tables->ray_length[dir][from]; i++) {
+        tables->direction_to[from][tables->ray_squares[dir][from][i]] = dir;
+      }
+    }
+  }
+
+  // Forward direction, starting rank and promotion rank for each color's
+  // pawns. Ranks are rows for red/yellow and columns for blue/green.
+  constexpr int kPawnForward[4][2] = {{-1, 0}, {0, 1}, {1, 0}, {0, -1}};
+  constexpr int kPawnStartRank[4] = {12, 1, 1, 12};
+  constexpr int kPawnPromotionRank[4] = {3, 10, 10, 3};
+  for (int color = 0; color < 4; color++) {
+    int delta_row = kPawnForward[color][0];
+    int delta_col = kPawnForward[color][1];
+    bool rank_is_row = delta_row != 0;
+    for (int square = 0; square < kNumSquares; square++) {
+      int row = square / 14;
+      int col = square % 14;
+      int rank = rank_is_row ? row : col;
+      uint8_t& push = tables->pawn_push[color][square];
+      uint8_t& double_push = tables->pawn_double_push[color][square];
+      push = kNumSquares;
+      double_push = kNumSquares;
+      if (!IsLegalSquare(row, col)) {
+        continue;
+      }
+      if (rank == kPawnPromotionRank[color]) {
+        tables->pawn_promotion[color].Set(square);
+      }
+      if (IsLegalSquare(row + delta_row, col + delta_col)) {
+        push = 14 * (row + delta_row) + col + delta_col;
+        if (rank == kPawnStartRank[color]
+            && IsLegalSquare(row + 2 * delta_row, col + 2 * delta_col)) {
+          double_push = 14 * (row + 2 * delta_row) + col + 2 * delta_col;
+        }
+      }
+    }
+  }
+
+  return tables;
+}
+
+}  // namespace
+
+const BitboardTables& GetBitboardTables() {
+  static const BitboardTables* tables = CreateBitboardTables();
+  return *tables;
+}
+
+}  // namespace chess
@@ -0,0 +1,219 @@
+#ifndef _BITBOARD_H_
+#define _BITBOARD_H_
+
+// 256-bit square sets for the 14x14 board.
+//
+// Squares are indexed as 14 * row + col (the same index used by
+// BoardLocation), so the 196 squares live in the low bits of four 64-bit
+// lanes. The top 60 bits of the last lane are always zero.
+
+#include <bit>
+#include <cstdint>
+
+namespace chess {
+
+constexpr int kNumSquares = 196;
+
+class Bitboard {
+ public:
+  constexpr Bitboard() : lanes_{0, 0, 0, 0} { }
+  constexpr Bitboard(uint64_t l0, uint64_t l1, uint64_t l2, uint64_t l3)
+    : lanes_{l0, l1, l2, l3} { }
+
+  static constexpr Bitboard FromSquare(int square) {
+    Bitboard bb;
+    bb.lanes_[square >> 6] = uint64_t(1) << (square & 63);
+    return bb;
+  }
+
+  constexpr bool Test(int square) const {
+    return (lanes_[square >> 6] >> (square & 63)) & 1;
+  }
+  constexpr void Set(int square) {
+    lanes_[square >> 6] |= uint64_t(1) << (square & 63);
+  }
+  constexpr void Clear(int square) {
+    lanes_[square >> 6] &= ~(uint64_t(1) << (square & 63));
+  }
+  constexpr void Toggle(int square) {
+    lanes_[square >> 6] ^= uint64_t(1) << (square & 63);
+  }
+
+  constexpr bool Empty() const {
+    return (lanes_[0] | lanes_[1] | lanes_[2] | lanes_[3]) == 0;
+  }
+  constexpr bool Any() const { return !Empty(); }
+  constexpr int Count() const {
+    return std::popcount(lanes_[0]) + std::popcount(lanes_[1])
+         + std::popcount(lanes_[2]) + std::popcount(lanes_[3]);
+  }
+
+  // Lowest / highest set square. Undefined on an empty set.
+  constexpr int Lsb() const {
+    for (int i = 0; i < 4; i++) {
+      if (lanes_[i]) {
+        return 64 * i + std::countr_zero(lanes_[i]);
+      }
+    }
+    return kNumSquares;
+  }
+  constexpr int Msb() const {
+    for (int i = 3; i >= 0; i--) {
+      if (lanes_[i]) {
+        return 64 * i + 63 - std::countl_zero(lanes_[i]);
+      }
+    }
+    return kNumSquares;
+  }
+  constexpr int PopLsb() {
+    int square = Lsb();
+    Clear(square);
+    return square;
+  }
+  constexpr int PopMsb() {
+    int square = Msb();
+    Clear(square);
+    return square;
+  }
+
+  constexpr Bitboard operator&(const Bitboard& o) const {
+    return Bitboard(lanes_[0] & o.lanes_[0], lanes_[1] & o.lanes_[1],
+                    lanes_[2] & o.lanes_[2], lanes_[3] & o.lanes_[3]);
+  }
+  constexpr Bitboard operator|(const Bitboard& o) const {
+    return Bitboard(lanes_[0] | o.lanes_[0], lanes_[1] | o.lanes_[1],
+                    lanes_[2] | o.lanes_[2], lanes_[3] | o.lanes_[3]);
+  }
+  constexpr Bitboard operator^(const Bitboard& o) const {
+    return Bitboard(lanes_[0] ^ o.lanes_[0], lanes_[1] ^ o.lanes_[1],
+                    lanes_[2] ^ o.lanes_[2], lanes_[3] ^ o.lanes_[3]);
+  }
+  // Note: the complement also sets the 60 unused bits; mask the result
+  // before counting or iterating it.
+  constexpr Bitboard operator~() const {
+    return Bitboard(~lanes_[0], ~lanes_[1], ~lanes_[2], ~lanes_[3]);
+  }
+  constexpr Bitboard& operator&=(const Bitboard& o) { return *this = *this & o; }
+  constexpr Bitboard& operator|=(const Bitboard& o) { return *this = *this | o; }
+  constexpr Bitboard& operator^=(const Bitboard& o) { return *this = *this ^ o; }
+
+  // Shift towards higher (<<) or lower (>>) square indices. 0 < n < 64.
+  constexpr Bitboard operator<<(int n) const {
+    return Bitboard(lanes_[0] << n,
+                    (lanes_[1] << n) | (lanes_[0] >> (64 - n)),
+                    (lanes_[2] << n) | (lanes_[1] >> (64 - n)),
+                    (lanes_[3] << n) | (lanes_[2] >> (64 - n)));
+  }
+  constexpr Bitboard operator>>(int n) const {
+    return Bitboard((lanes_[0] >> n) | (lanes_[1] << (64 - n)),
+                    (lanes_[1] >> n) | (lanes_[2] << (64 - n)),
+                    (lanes_[2] >> n) | (lanes_[3] << (64 - n)),
+                    lanes_[3] >> n);
+  }
+  // Shift by a signed square delta.
+  constexpr Bitboard Shift(int delta) const {
+    return delta > 0 ? *this << delta : delta < 0 ? *this >> -delta : *this;
+  }
+
+  constexpr bool operator==(const Bitboard& o) const {
+    return lanes_[0] == o.lanes_[0] && lanes_[1] == o.lanes_[1]
+        && lanes_[2] == o.lanes_[2] && lanes_[3] == o.lanes_[3];
+  }
+  constexpr bool operator!=(const Bitboard& o) const { return !(*this == o); }
+
+  constexpr uint64_t Lane(int i) const { return lanes_[i]; }
+
+ private:
+  uint64_t lanes_[4];
+};
+
+// Directions used for sliding pieces. The first four move towards lower
+// square indices, the last four towards higher ones.
+enum Direction : int8_t {
+  NORTH_WEST = 0, NORTH = 1, NORTH_EAST = 2, WEST = 3,
+  EAST = 4, SOUTH_WEST = 5, SOUTH = 6, SOUTH_EAST = 7,
+};
+
+constexpr int kNumDirections = 8;
+constexpr int kDirectionRow[kNumDirections] = {-1, -1, -1, 0, 0, 1, 1, 1};
+constexpr int kDirectionCol[kNumDirections] = {-1, 0, 1, -1, 1, -1, 0, 1};
+
+constexpr int DirectionFromDelta(int delta_row, int delta_col) {
+  constexpr int kDirections[3][3] = {
+    {NORTH_WEST, NORTH, NORTH_EAST},
+    {WEST, -1, EAST},
+    {SOUTH_WEST, SOUTH, SOUTH_EAST},
+  };
+  return kDirections[delta_row + 1][delta_col + 1];
+}
+
+constexpr bool IsPositiveDirection(int dir) { return dir >= EAST; }
+constexpr bool IsDiagonalDirection(int dir) {
+  return kDirectionRow[dir] != 0 && kDirectionCol[dir] != 0;
+}
+
+constexpr bool IsLegalSquare(int row, int col) {
+  return row >= 0 && row < 14 && col >= 0 && col < 14
+      && !((row < 3 || row > 10) && (col < 3 || col > 10));
+}
+
+// Precomputed square sets, built once at startup.
+struct BitboardTables {
+  Bitboard legal;
+  Bitboard knight_attacks[kNumSquares];
+  Bitboard king_attacks[kNumSquares];
+  // Squares attacked by a pawn of the given color standing on the square.
+  Bitboard pawn_attacks[4][kNumSquares];
+  // Squares from which a pawn of the given color attacks the square.
+  Bitboard pawn_attackers[4][kNumSquares];
+  // All legal squares strictly beyond the square in the given direction, up
+  // to the board edge or the first cut-off corner square.
+  Bitboard rays[kNumDirections][kNumSquares];
+  // The squares of each ray in order, nearest first.
+  uint8_t ray_squares[kNumDirections][kNumSquares][13];
+  uint8_t ray_length[kNumDirections][kNumSquares];
+  // Direction in which `to` lies on a ray from `from`, or -1.
+  int8_t direction_to[kNumSquares][kNumSquares];
+
+  // Pawn pushes by color. kNumSquares marks a missing target; double pushes
+  // are only set on the pawn's starting rank.
+  uint8_t pawn_push[4][kNumSquares];
+  uint8_t pawn_double_push[4][kNumSquares];
+  // Squares on which a pawn of the given color promotes.
+  Bitboard pawn_promotion[4];
+};
+
+const BitboardTables& GetBitboardTables();
+
+// Squares attacked by a slider on `square` along `dir`, stopping at (and
+// including) the first occupied square.
+inline Bitboard RayAttacks(const BitboardTables& tables, int dir, int square,
+                           const Bitboard& occupied) {
+  Bitboard ray = tables.rays[dir][square];
+  Bitboard blockers = ray & occupied;
+  if (blockers.Any()) {
+    int blocker = IsPositiveDirection(dir) ? blockers.Lsb() : blockers.Msb();
+    ray ^= tables.rays[dir][blocker];
+  }
+  return ray;
+}
+
+inline Bitboard RookAttacks(const BitboardTables& tables, int square,
+                            const Bitboard& occupied) {
+  return RayAttacks(tables, NORTH, square, occupied)
+       | RayAttacks(tables, WEST, square, occupied)
+       | RayAttacks(tables, EAST, square, occupied)
+       | RayAttacks(tables, SOUTH, square, occupied);
+}
+
+inline Bitboard BishopAttacks(const BitboardTables& tables, int square,
+                              const Bitboard& occupied) {
+  return RayAttacks(tables, NORTH_WEST, square, occupied)
+       | RayAttacks(tables, NORTH_EAST, square, occupied)
+       | RayAttacks(tables, SOUTH_WEST, square, occupied)
+       | RayAttacks(tables, SOUTH_EAST, square, occupied);
+}
+
+}  // namespace chess
+
+#endif  // _BITBOARD_H_
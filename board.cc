@@ -2,6 +2,7 @@
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <optional>
 #include <ostream>
@@ -63,10 +64,101 @@ const Piece kGreenKing(kGreenPlayer, KING);
 
 namespace {
 
-int64_t rand64() {
-  int32_t t0 = rand();
-  int32_t t1 = rand();
-  return (((int64_t)t0) << 32) + (int64_t)t1;
+// Size of the move buffers used outside of search, which hold every move of
+// one player.
+constexpr size_t kMaxScratchMoves = 300;
+
+// Conversions between square indices (14 * row + col) and padded mailbox
+// indices. Off-board padded squares map to 196.
+struct PaddedSquareTables {
+  int16_t to_padded[kNumSquares];
+  uint8_t to_square[kPaddedSquares];
+};
+
+constexpr PaddedSquareTables CreatePaddedSquareTables() {
+  PaddedSquareTables tables{};
+  for (int index = 0; index < kPaddedSquares; index++) {
+    tables.to_square[index] = kNumSquares;
+  }
+  for (int row = 0; row < 14; row++) {
+    for (int col = 0; col < 14; col++) {
+      tables.to_padded[14 * row + col] = PaddedIndex(row, col);
+      if (IsLegalSquare(row, col)) {
+        tables.to_square[PaddedIndex(row, col)] = 14 * row + col;
+      }
+    }
+  }
+  return tables;
+}
+
+constexpr PaddedSquareTables kPaddedSquareTables = CreatePaddedSquareTables();
+
+inline int ToPadded(const BoardLocation& location) {
+  return kPaddedSquareTables.to_padded[location.GetSquare()];
+}
+
+inline BoardLocation FromPadded(int index) {
+  return BoardLocation::FromSquare(kPaddedSquareTables.to_square[index]);
+}
+
+// Direction from the king towards the rook, indexed by color and
+// is_kingside.
+constexpr Direction kCastlingDirection[4][2] = {
+  {WEST, EAST},    // RED
+  {NORTH, SOUTH},  // BLUE
+  {EAST, WEST},    // YELLOW
+  {SOUTH, NORTH},  // GREEN
+};
+
+// In increasing order, so that both layouts emit moves in the same order.
+constexpr int kPaddedKnightOffsets[8] = {
+  PaddedOffset(-2, -1), PaddedOffset(-2, 1),
+  PaddedOffset(-1, -2), PaddedOffset(-1, 2),
+  PaddedOffset(1, -2), PaddedOffset(1, 2),
+  PaddedOffset(2, -1), PaddedOffset(2, 1),
+};
+constexpr int kPaddedKingOffsets[8] = {
+  PaddedOffset(-1, -1), PaddedOffset(-1, 0), PaddedOffset(-1, 1),
+  PaddedOffset(0, -1), PaddedOffset(0, 1),
+  PaddedOffset(1, -1), PaddedOffset(1, 0), PaddedOffset(1, 1),
+};
+
+// Whether a knight or king of `team` may step onto a padded square holding
+// `other` when generating moves of the given type.
+inline bool IsPaddedTarget(const Piece& other, Team team, MoveGenType type) {
+  if (other.Missing()) {
+    return type != GEN_CAPTURES;
+  }
+  return type != GEN_QUIETS && !other.IsOffBoard() && other.GetTeam() != team;
+}
+
+constexpr uint64_t kZobristSeed = 958829;
+
+// https://prng.di.unimi.it/splitmix64.c
+constexpr uint64_t SplitMix64(uint64_t& state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys MakeZobristKeys() {
+  ZobristKeys keys = {};
+  uint64_t state = kZobristSeed;
+  for (int color = 0; color < 4; color++) {
+    keys.turn[color] = static_cast<int64_t>(SplitMix64(state));
+  }
+  for (int color = 0; color < 4; color++) {
+    for (int piece_type = 0; piece_type < 6; piece_type++) {
+      for (int row = 0; row < 14; row++) {
+        for (int col = 0; col < 14; col++) {
+          keys.piece[color][piece_type][row][col] =
+            static_cast<int64_t>(SplitMix64(state));
+        }
+      }
+    }
+  }
+  return keys;
 }
 
 
@@ -78,30 +170,8 @@ void AddPawnMoves2(
     const Piece capture = Piece::kNoPiece,
     const BoardLocation en_passant_location = BoardLocation::kNoLocation,
     const Piece en_passant_capture = Piece::kNoPiece) {
-  bool is_promotion = false;
-
-  constexpr int kRedPromotionRow = 3;
-  constexpr int kYellowPromotionRow = 10;
-  constexpr int kBluePromotionCol = 10;
-  constexpr int kGreenPromotionCol = 3;
-
-  switch (color) {
-  case RED:
-    is_promotion = to.GetRow() == kRedPromotionRow;
-    break;
-  case BLUE:
-    is_promotion = to.GetCol() == kBluePromotionCol;
-    break;
-  case YELLOW:
-    is_promotion = to.GetRow() == kYellowPromotionRow;
-    break;
-  case GREEN:
-    is_promotion = to.GetCol() == kGreenPromotionCol;
-    break;
-  default:
-    assert(false);
-    break;
-  }
+  bool is_promotion = GetBitboardTables().pawn_promotion[color]
+    .Test(to.GetSquare());
 
   if (is_promotion) {
     moves.emplace_back(from, to, capture, en_passant_location, en_passant_capture, KNIGHT);
@@ -115,142 +185,134 @@ void AddPawnMoves2(
 
 }  // namespace
 
+constexpr ZobristKeys kZobristKeys = MakeZobristKeys();
+
+Bitboard Board::GetMoveTargets(Team team, MoveGenType type) const {
+  switch (type) {
+    case GEN_CAPTURES:
+      return team_bitboards_[OtherTeam(team)];
+    case GEN_QUIETS:
+      return ~GetOccupied();
+    default:
+      return ~team_bitboards_[team];
+  }
+}
+
 void Board::GetPawnMoves2(
     MoveBuffer& moves,
     const BoardLocation& from,
-    const Piece& piece) const {
+    const Piece& piece,
+    MoveGenType type) const {
+  const auto& tables = GetBitboardTables();
   PlayerColor color = piece.GetColor();
   Team team = piece.GetTeam();
 
   // Move forward
-  int delta_rows = 0;
-  int delta_cols = 0;
-  bool not_moved = false;
-  switch (color) {
-  case RED:
-    delta_rows = -1;
-    not_moved = from.GetRow() == 12;
-    break;
-  case BLUE:
-    delta_cols = 1;
-    not_moved = from.GetCol() == 1;
-    break;
-  case YELLOW:
-    delta_rows = 1;
-    not_moved = from.GetRow() == 1;
-    break;
-  case GREEN:
-    delta_cols = -1;
-    not_moved = from.GetCol() == 12;
-    break;
-  default:
-    assert(false);
-    break;
-  }
-
-  BoardLocation to = from.Relative(delta_rows, delta_cols);
-  if (IsLegalLocation(to)) {
+  int push = tables.pawn_push[color][from.GetSquare()];
+  if (push != kNumSquares) {
+    BoardLocation to = BoardLocation::FromSquare(push);
     Piece other_piece = GetPiece(to);
     if (other_piece.Missing()) {
-      // Advance once square
-      AddPawnMoves2(moves, from, to, piece.GetColor());
-      // Initial move (advance 2 squares)
-      if (not_moved) {
-        to = from.Relative(delta_rows * 2, delta_cols * 2);
-        other_piece = GetPiece(to);
-        if (other_piece.Missing()) {
-          AddPawnMoves2(moves, from, to, piece.GetColor());
+      if (type != GEN_CAPTURES) {
+        // Advance once square
+        AddPawnMoves2(moves, from, to, piece.GetColor());
+        // Initial move (advance 2 squares)
+        int double_push = tables.pawn_double_push[color][from.GetSquare()];
+        if (double_push != kNumSquares) {
+          to = BoardLocation::FromSquare(double_push);
+          other_piece = GetPiece(to);
+          if (other_piece.Missing()) {
+            AddPawnMoves2(moves, from, to, piece.GetColor());
+          }
         }
       }
-    } else {
+    } else if (type != GEN_QUIETS) {
 
       // En-passant
-      if (other_piece.GetPieceType() == PAWN
-          && piece.GetTeam() != other_piece.GetTeam()) {
-
-        int n_turns = (4 + piece.GetColor() - other_piece.GetColor()) % 4;
-        const Move* other_player_move = nullptr;
-        if (n_turns > 0 && n_turns <= (int)moves_.size()) {
-          other_player_move = &moves_[moves_.size() - n_turns];
-        } else if (n_turns < 4) {
-          const auto& enp_move = enp_.enp_moves[other_piece.GetColor()];
-          if (enp_move.has_value()) {
-            other_player_move = &*enp_move;
-          }
-        }
-
-        if (other_player_move != nullptr
-            && other_player_move->To() == to
-            // TODO: Refactor this with 'enp' locations
-            && other_player_move->ManhattanDistance() == 2
-            && (other_player_move->From().GetRow() == other_player_move->To().GetRow()
-               || other_player_move->From().GetCol() == other_player_move->To().GetCol())
-            ) {
-          const BoardLocation& moved_from = other_player_move->From();
-          int delta_row = to.GetRow() - moved_from.GetRow();
-          int delta_col = to.GetCol() - moved_from.GetCol();
-          BoardLocation enpassant_to = moved_from.Relative(
-              delta_row / 2, delta_col / 2);
-          // there may be both en-passant and piece capture in the same move
-          auto existing = GetPiece(enpassant_to);
-          if (existing.Missing()
-              || existing.GetTeam() != piece.GetTeam()) {
-            AddPawnMoves2(moves, from, enpassant_to, piece.GetColor(),
-                         existing, to, other_piece);
-          }
+      BoardLocation enpassant_to = GetEnpassantTarget(piece, to, other_piece);
+      if (enpassant_to.Present()) {
+        // there may be both en-passant and piece capture in the same move
+        auto existing = GetPiece(enpassant_to);
+        if (existing.Missing()
+            || existing.GetTeam() != piece.GetTeam()) {
+          AddPawnMoves2(moves, from, enpassant_to, piece.GetColor(),
+                       existing, to, other_piece);
         }
-
       }
 
     }
   }
 
   // Non-enpassant capture
-  bool check_cols = team == RED_YELLOW;
-  int capture_row, capture_col;
-  for (int incr = 0; incr < 2; ++incr) {
-    capture_row = from.GetRow() + delta_rows;
-    capture_col = from.GetCol() + delta_cols;
-    if (check_cols) {
-      capture_col += incr == 0 ? -1 : 1;
-    } else {
-      capture_row += incr == 0 ? -1 : 1;
-    }
-    if (IsLegalLocation(capture_row, capture_col)) {
-      auto other_piece = GetPiece(capture_row, capture_col);
-      if (other_piece.Present()
-          && other_piece.GetTeam() != team) {
-        AddPawnMoves2(moves, from, BoardLocation(capture_row, capture_col),
-            piece.GetColor(), other_piece);
-      }
+  if (type == GEN_QUIETS) {
+    return;
+  }
+  Bitboard captures = tables.pawn_attacks[color][from.GetSquare()]
+    & team_bitboards_[OtherTeam(team)];
+  while (captures.Any()) {
+    BoardLocation to = BoardLocation::FromSquare(captures.PopLsb());
+    AddPawnMoves2(moves, from, to, piece.GetColor(), GetPiece(to));
+  }
+}
+
+BoardLocation Board::GetEnpassantTarget(
+    const Piece& piece,
+    const BoardLocation& to,
+    const Piece& other_piece) const {
+  if (other_piece.GetPieceType() != PAWN
+      || piece.GetTeam() == other_piece.GetTeam()) {
+    return BoardLocation::kNoLocation;
+  }
+
+  int n_turns = (4 + piece.GetColor() - other_piece.GetColor()) % 4;
+  const Move* other_player_move = nullptr;
+  if (n_turns > 0 && n_turns <= num_plies_) {
+    other_player_move = &GetUndoState(num_plies_ - n_turns).move;
+  } else if (n_turns < 4) {
+    const auto& enp_move = enp_.enp_moves[other_piece.GetColor()];
+    if (enp_move.has_value()) {
+      other_player_move = &*enp_move;
     }
   }
+
+  if (other_player_move == nullptr
+      || other_player_move->To() != to
+      // TODO: Refactor this with 'enp' locations
+      || other_player_move->ManhattanDistance() != 2
+      || (other_player_move->From().GetRow() != other_player_move->To().GetRow()
+          && other_player_move->From().GetCol() != other_player_move->To().GetCol())
+      ) {
+    return BoardLocation::kNoLocation;
+  }
+  const BoardLocation& moved_from = other_player_move->From();
+  int delta_row = to.GetRow() - moved_from.GetRow();
+  int delta_col = to.GetCol() - moved_from.GetCol();
+  return moved_from.Relative(delta_row / 2, delta_col / 2);
 }
 
 void Board::GetKnightMoves2(
     MoveBuffer& moves,
     const BoardLocation& from,
-    const Piece& piece) const {
-
-  int delta_row, delta_col;
-  for (int pos_row_sign = 0; pos_row_sign < 2; ++pos_row_sign) {
-    for (int abs_delta_row = 1; abs_delta_row < 3; ++abs_delta_row) {
-      delta_row = pos_row_sign > 0 ? abs_delta_row : -abs_delta_row;
-      for (int pos_col_sign = 0; pos_col_sign < 2; ++pos_col_sign) {
-        int abs_delta_col = abs_delta_row == 1 ? 2 : 1;
-        delta_col = pos_col_sign > 0 ? abs_delta_col : -abs_delta_col;
-        BoardLocation to = from.Relative(delta_row, delta_col);
-        if (IsLegalLocation(to)) {
-          const auto capture = GetPiece(to);
-          if (capture.Missing()
-              || capture.GetTeam() != piece.GetTeam()) {
-            moves.emplace_back(from, to, capture);
-          }
-        }
+    const Piece& piece,
+    MoveGenType type) const {
+  if (layout_ == LAYOUT_PADDED_MAILBOX) {
+    int index = ToPadded(from);
+    Team team = piece.GetTeam();
+    for (int offset : kPaddedKnightOffsets) {
+      const Piece& other = padded_board_[index + offset];
+      if (IsPaddedTarget(other, team, type)) {
+        moves.emplace_back(from, FromPadded(index + offset), other);
       }
     }
+    return;
   }
 
+  Bitboard targets = GetBitboardTables().knight_attacks[from.GetSquare()]
+    & GetMoveTargets(piece.GetTeam(), type);
+  while (targets.Any()) {
+    BoardLocation to = BoardLocation::FromSquare(targets.PopLsb());
+    moves.emplace_back(from, to, GetPiece(to));
+  }
 }
 
 void Board::AddMovesFromIncrMovement(
@@ -258,23 +320,22 @@ void Board::AddMovesFromIncrMovement(
     const Piece& piece,
     const BoardLocation& from,
     int incr_row,
-    int incr_col,
-    CastlingRights initial_castling_rights,
-    CastlingRights castling_rights) const {
-  BoardLocation to = from.Relative(incr_row, incr_col);
-  while (IsLegalLocation(to)) {
+    int incr_col) const {
+  const auto& tables = GetBitboardTables();
+  int dir = DirectionFromDelta(incr_row, incr_col);
+  int square = from.GetSquare();
+  for (int i = 0; i < tables.ray_length[dir][square]; ++i) {
+    BoardLocation to = BoardLocation::FromSquare(
+        tables.ray_squares[dir][square][i]);
     const auto capture = GetPiece(to);
     if (capture.Missing()) {
-      moves.emplace_back(from, to, Piece::kNoPiece, initial_castling_rights,
-          castling_rights);
+      moves.emplace_back(from, to);
     } else {
       if (capture.GetTeam() != piece.GetTeam()) {
-        moves.emplace_back(from, to, capture, initial_castling_rights,
-            castling_rights);
+        moves.emplace_back(from, to, capture);
       }
       break;
     }
-    to = to.Relative(incr_row, incr_col);
   }
 }
 
@@ -284,34 +345,55 @@ void Board::AddMovesFromIncrMovement2(
     const BoardLocation& from,
     int incr_row,
     int incr_col,
-    CastlingRights initial_castling_rights,
-    CastlingRights castling_rights) const {
-  BoardLocation to = from.Relative(incr_row, incr_col);
-  while (IsLegalLocation(to)) {
-    const auto capture = GetPiece(to);
-    if (capture.Missing()) {
-      moves.emplace_back(from, to, Piece::kNoPiece, initial_castling_rights,
-          castling_rights);
-    } else {
-      if (capture.GetTeam() != piece.GetTeam()) {
-        moves.emplace_back(from, to, capture, initial_castling_rights,
-            castling_rights);
-      }
-      break;
+    MoveGenType type) const {
+  if (layout_ == LAYOUT_PADDED_MAILBOX) {
+    AddMovesFromPaddedRay(moves, piece, from, PaddedOffset(incr_row, incr_col),
+        type);
+    return;
+  }
+  int dir = DirectionFromDelta(incr_row, incr_col);
+  Bitboard targets = RayAttacks(
+      GetBitboardTables(), dir, from.GetSquare(), GetOccupied())
+    & GetMoveTargets(piece.GetTeam(), type);
+  // Emit the squares nearest to the piece first.
+  bool positive = IsPositiveDirection(dir);
+  while (targets.Any()) {
+    BoardLocation to = BoardLocation::FromSquare(
+        positive ? targets.PopLsb() : targets.PopMsb());
+    moves.emplace_back(from, to, GetPiece(to));
+  }
+}
+
+void Board::AddMovesFromPaddedRay(
+    MoveBuffer& moves,
+    const Piece& piece,
+    const BoardLocation& from,
+    int offset,
+    MoveGenType type) const {
+  int index = ToPadded(from) + offset;
+  while (padded_board_[index].Missing()) {
+    if (type != GEN_CAPTURES) {
+      moves.emplace_back(from, FromPadded(index));
     }
-    to = to.Relative(incr_row, incr_col);
+    index += offset;
+  }
+  const Piece& capture = padded_board_[index];
+  if (type != GEN_QUIETS
+      && !capture.IsOffBoard() && capture.GetTeam() != piece.GetTeam()) {
+    moves.emplace_back(from, FromPadded(index), capture);
   }
 }
 
 void Board::GetBishopMoves2(
     MoveBuffer& moves,
     const BoardLocation& from,
-    const Piece& piece) const {
+    const Piece& piece,
+    MoveGenType type) const {
 
   for (int pos_row = 0; pos_row < 2; ++pos_row) {
     for (int pos_col = 0; pos_col < 2; ++pos_col) {
       AddMovesFromIncrMovement2(
-          moves, piece, from, pos_row ? 1 : -1, pos_col ? 1 : -1);
+          moves, piece, from, pos_row ? 1 : -1, pos_col ? 1 : -1, type);
     }
   }
 }
@@ -319,29 +401,8 @@ void Board::GetBishopMoves2(
 void Board::GetRookMoves2(
     MoveBuffer& moves,
     const BoardLocation& from,
-    const Piece& piece) const {
-
-  // Update castling rights
-  CastlingRights initial_castling_rights;
-  CastlingRights castling_rights;
-  std::optional<CastlingType> castling_type = GetRookLocationType(
-      piece.GetPlayer(), from);
-  if (castling_type.has_value()) {
-    const auto& curr_rights = castling_rights_[piece.GetColor()];
-    if (curr_rights.Kingside() || curr_rights.Queenside()) {
-      if (castling_type == KINGSIDE) {
-        if (curr_rights.Kingside()) {
-          initial_castling_rights = curr_rights;
-          castling_rights = CastlingRights(false, curr_rights.Queenside());
-        }
-      } else {
-        if (curr_rights.Queenside()) {
-          initial_castling_rights = curr_rights;
-          castling_rights = CastlingRights(curr_rights.Kingside(), false);
-        }
-      }
-    }
-  }
+    const Piece& piece,
+    MoveGenType type) const {
 
   for (int do_pos_incr = 0; do_pos_incr < 2; ++do_pos_incr) {
     int incr = do_pos_incr > 0 ? 1 : -1;
@@ -349,7 +410,7 @@ void Board::GetRookMoves2(
       int incr_row = do_incr_row > 0 ? incr : 0;
       int incr_col = do_incr_row > 0 ? 0 : incr;
       AddMovesFromIncrMovement2(moves, piece, from, incr_row, incr_col,
-          initial_castling_rights, castling_rights);
+          type);
     }
   }
 }
@@ -357,113 +418,63 @@ void Board::GetRookMoves2(
 void Board::GetQueenMoves2(
     MoveBuffer& moves,
     const BoardLocation& from,
-    const Piece& piece) const {
-  GetBishopMoves2(moves, from, piece);
-  GetRookMoves2(moves, from, piece);
+    const Piece& piece,
+    MoveGenType type) const {
+  GetBishopMoves2(moves, from, piece, type);
+  GetRookMoves2(moves, from, piece, type);
 }
 
 void Board::GetKingMoves2(
     MoveBuffer& moves,
     const BoardLocation& from,
-    const Piece& piece) const {
+    const Piece& piece,
+    MoveGenType type) const {
 
-  const CastlingRights& initial_castling_rights = castling_rights_[piece.GetColor()];
-  CastlingRights castling_rights(false, false);
+  const auto& tables = GetBitboardTables();
 
-  for (int delta_row = -1; delta_row < 2; ++delta_row) {
-    for (int delta_col = -1; delta_col < 2; ++delta_col) {
-      if (delta_row == 0 && delta_col == 0) {
-        continue;
-      }
-      BoardLocation to = from.Relative(delta_row, delta_col);
-      if (IsLegalLocation(to)) {
-        const auto capture = GetPiece(to);
-        if (capture.Missing()
-            || capture.GetTeam() != piece.GetTeam()) {
-          moves.emplace_back(from, to, capture, initial_castling_rights,
-              castling_rights);
-        }
+  if (layout_ == LAYOUT_PADDED_MAILBOX) {
+    int index = ToPadded(from);
+    Team team = piece.GetTeam();
+    for (int offset : kPaddedKingOffsets) {
+      const Piece& other = padded_board_[index + offset];
+      if (IsPaddedTarget(other, team, type)) {
+        moves.emplace_back(from, FromPadded(index + offset), other);
       }
     }
+  } else {
+    Bitboard targets = tables.king_attacks[from.GetSquare()]
+      & GetMoveTargets(piece.GetTeam(), type);
+    while (targets.Any()) {
+      BoardLocation to = BoardLocation::FromSquare(targets.PopLsb());
+      moves.emplace_back(from, to, GetPiece(to));
+    }
+  }
+
+  if (type != GEN_CAPTURES) {
+    GetCastlingMoves2(moves, from, piece);
   }
+}
 
+void Board::GetCastlingMoves2(
+    MoveBuffer& moves,
+    const BoardLocation& from,
+    const Piece& piece) const {
+  const auto& tables = GetBitboardTables();
+  const CastlingRights& castling_rights = castling_rights_[piece.GetColor()];
   Team other_team = OtherTeam(piece.GetTeam());
   for (int is_kingside = 0; is_kingside < 2; ++is_kingside) {
-    bool allowed = is_kingside ? initial_castling_rights.Kingside() :
-      initial_castling_rights.Queenside();
+    bool allowed = is_kingside ? castling_rights.Kingside() :
+      castling_rights.Queenside();
     if (allowed) {
-      std::vector<BoardLocation> squares_between;
-      BoardLocation rook_location;
-
-      switch (piece.GetColor()) {
-      case RED:
-        if (is_kingside) {
-          squares_between = {
-            from.Relative(0, 1),
-            from.Relative(0, 2),
-          };
-          rook_location = from.Relative(0, 3);
-        } else {
-          squares_between = {
-            from.Relative(0, -1),
-            from.Relative(0, -2),
-            from.Relative(0, -3),
-          };
-          rook_location = from.Relative(0, -4);
-        }
-        break;
-      case BLUE:
-        if (is_kingside) {
-          squares_between = {
-            from.Relative(1, 0),
-            from.Relative(2, 0),
-          };
-          rook_location = from.Relative(3, 0);
-        } else {
-          squares_between = {
-            from.Relative(-1, 0),
-            from.Relative(-2, 0),
-            from.Relative(-3, 0),
-          };
-          rook_location = from.Relative(-4, 0);
-        }
-        break;
-      case YELLOW:
-        if (is_kingside) {
-          squares_between = {
-            from.Relative(0, -1),
-            from.Relative(0, -2),
-          };
-          rook_location = from.Relative(0, -3);
-        } else {
-          squares_between = {
-            from.Relative(0, 1),
-            from.Relative(0, 2),
-            from.Relative(0, 3),
-          };
-          rook_location = from.Relative(0, 4);
-        }
-        break;
-      case GREEN:
-        if (is_kingside) {
-          squares_between = {
-            from.Relative(-1, 0),
-            from.Relative(-2, 0),
-          };
-          rook_location = from.Relative(-3, 0);
-        } else {
-          squares_between = {
-            from.Relative(1, 0),
-            from.Relative(2, 0),
-            from.Relative(3, 0),
-          };
-          rook_location = from.Relative(4, 0);
-        }
-        break;
-      default:
-        assert(false);
-        break;
+      // The squares between the king and the rook, then the rook itself.
+      int dir = kCastlingDirection[piece.GetColor()][is_kingside];
+      const uint8_t* ray = tables.ray_squares[dir][from.GetSquare()];
+      int num_between = is_kingside ? 2 : 3;
+      if (tables.ray_length[dir][from.GetSquare()] <= num_between) {
+        continue;
       }
+      BoardLocation rook_location = BoardLocation::FromSquare(
+          ray[num_between]);
 
       // Make sure the rook is present
       const auto rook = GetPiece(rook_location);
@@ -475,21 +486,22 @@ void Board::GetKingMoves2(
 
       // Make sure that there are no pieces between the king and rook
       bool piece_between = false;
-      for (const auto& loc : squares_between) {
-        if (GetPiece(loc).Present()) {
+      for (int i = 0; i < num_between; ++i) {
+        if (GetOccupied().Test(ray[i])) {
           piece_between = true;
           break;
         }
       }
 
       if (!piece_between) {
+        BoardLocation king_passes = BoardLocation::FromSquare(ray[0]);
         // Make sure the king is not currently in or would pass through check
-        if (!IsAttackedByTeam(other_team, squares_between[0])
+        if (!IsAttackedByTeam(other_team, king_passes)
             && !IsAttackedByTeam(other_team, from)) {
           // Additionally move the castle
-          SimpleMove rook_move(rook_location, squares_between[0]);
-          moves.emplace_back(from, squares_between[1], rook_move,
-              initial_castling_rights, castling_rights);
+          SimpleMove rook_move(rook_location, king_passes);
+          moves.emplace_back(from, BoardLocation::FromSquare(ray[1]),
+              rook_move);
         }
       }
     }
@@ -499,73 +511,15 @@ void Board::GetKingMoves2(
 bool Board::RookAttacks(
     const BoardLocation& rook_loc,
     const BoardLocation& other_loc) const {
-  if (rook_loc.GetRow() == other_loc.GetRow()) {
-    bool piece_between = false;
-    for (int col = std::min(rook_loc.GetCol(), other_loc.GetCol()) + 1;
-         col < std::max(rook_loc.GetCol(), other_loc.GetCol());
-         ++col) {
-      if (GetPiece(rook_loc.GetRow(), col).Present()) {
-        piece_between = true;
-        break;
-      }
-    }
-    if (!piece_between) {
-      return true;
-    }
-  }
-  if (rook_loc.GetCol() == other_loc.GetCol()) {
-    bool piece_between = false;
-    for (int row = std::min(rook_loc.GetRow(), other_loc.GetRow()) + 1;
-         row < std::max(rook_loc.GetRow(), other_loc.GetRow());
-         ++row) {
-      if (GetPiece(row, rook_loc.GetCol()).Present()) {
-        piece_between = true;
-        break;
-      }
-    }
-    if (!piece_between) {
-      return true;
-    }
-  }
-  return false;
+  return chess::RookAttacks(GetBitboardTables(), rook_loc.GetSquare(),
+      GetOccupied()).Test(other_loc.GetSquare());
 }
 
 bool Board::BishopAttacks(
     const BoardLocation& bishop_loc,
     const BoardLocation& other_loc) const {
-  int delta_row = bishop_loc.GetRow() - other_loc.GetRow();
-  int delta_col = bishop_loc.GetCol() - other_loc.GetCol();
-  if (std::abs(delta_row) == std::abs(delta_col)) {
-    int row;
-    int col;
-    int col_incr;
-    int row_max;
-    if (bishop_loc.GetRow() < other_loc.GetRow()) {
-      row = bishop_loc.GetRow();
-      col = bishop_loc.GetCol();
-      row_max = other_loc.GetRow();
-      col_incr = bishop_loc.GetCol() < other_loc.GetCol() ? 1 : -1;
-    } else {
-      row = other_loc.GetRow();
-      col = other_loc.GetCol();
-      row_max = bishop_loc.GetRow();
-      col_incr = other_loc.GetCol() < bishop_loc.GetCol() ? 1 : -1;
-    }
-    row++;
-    col += col_incr;
-    bool piece_between = false;
-    while (row < row_max) {
-      if (GetPiece(row, col).Present()) {
-        piece_between = true;
-        break;
-      }
-
-      ++row;
-      col += col_incr;
-    }
-    return !piece_between;
-  }
-  return false;
+  return chess::BishopAttacks(GetBitboardTables(), bishop_loc.GetSquare(),
+      GetOccupied()).Test(other_loc.GetSquare());
 }
 
 bool Board::QueenAttacks(
@@ -578,187 +532,268 @@ bool Board::QueenAttacks(
 bool Board::KingAttacks(
     const BoardLocation& king_loc,
     const BoardLocation& other_loc) const {
-  if ((std::abs(king_loc.GetRow() - other_loc.GetRow())
-        + std::abs(king_loc.GetCol() - other_loc.GetCol())) < 2) {
-    return true;
-  }
-  return false;
+  return GetBitboardTables().king_attacks[king_loc.GetSquare()]
+    .Test(other_loc.GetSquare());
 }
 
 bool Board::KnightAttacks(
     const BoardLocation& knight_loc,
     const BoardLocation& other_loc) const {
-  int abs_row_diff = std::abs(knight_loc.GetRow() - other_loc.GetRow());
-  int abs_col_diff = std::abs(knight_loc.GetCol() - other_loc.GetCol());
-  return (abs_row_diff == 1 && abs_col_diff == 2)
-    || (abs_row_diff == 2 && abs_col_diff == 1);
+  return GetBitboardTables().knight_attacks[knight_loc.GetSquare()]
+    .Test(other_loc.GetSquare());
 }
 
 bool Board::PawnAttacks(
     const BoardLocation& pawn_loc,
     PlayerColor pawn_color,
     const BoardLocation& other_loc) const {
-  int row_diff = other_loc.GetRow() - pawn_loc.GetRow();
-  int col_diff = other_loc.GetCol() - pawn_loc.GetCol();
-  switch (pawn_color) {
-  case RED:
-    return row_diff == -1 && (std::abs(col_diff) == 1);
-  case BLUE:
-    return col_diff == 1 && (std::abs(row_diff) == 1);
-  case YELLOW:
-    return row_diff == 1 && (std::abs(col_diff) == 1);
-  case GREEN:
-    return col_diff == -1 && (std::abs(row_diff) == 1);
+  return GetBitboardTables().pawn_attacks[pawn_color][pawn_loc.GetSquare()]
+    .Test(other_loc.GetSquare());
+}
+
+Bitboard Board::GetAttacks(
+    const Piece& piece, int square, const Bitboard& occupied) const {
+  const auto& tables = GetBitboardTables();
+  switch (piece.GetPieceType()) {
+  case PAWN:
+    return tables.pawn_attacks[piece.GetColor()][square];
+  case KNIGHT:
+    return tables.knight_attacks[square];
+  case BISHOP:
+    return chess::BishopAttacks(tables, square, occupied);
+  case ROOK:
+    return chess::RookAttacks(tables, square, occupied);
+  case QUEEN:
+    return chess::BishopAttacks(tables, square, occupied)
+         | chess::RookAttacks(tables, square, occupied);
+  case KING:
+    return tables.king_attacks[square];
   default:
-    assert(false);
-    return false;
+    return Bitboard();
+  }
+}
+
+Threats Board::GetThreats(
+    Team team, const int piece_evaluations[6], int margin) const {
+  const Bitboard& occupied = GetOccupied();
+  const Team enemy_team = OtherTeam(team);
+  // Indexed by the type of the attacking piece.
+  Bitboard enemy_attacks[6];
+  Bitboard defended;
+  for (int color = 0; color < 4; color++) {
+    if (!king_locations_[color].Present()) {
+      continue;
+    }
+    bool enemy = GetTeam(static_cast<PlayerColor>(color)) == enemy_team;
+    for (const auto& placed_piece : piece_list_[color]) {
+      const Piece& piece = placed_piece.GetPiece();
+      Bitboard attacks = GetAttacks(
+          piece, placed_piece.GetLocation().GetSquare(), occupied);
+      if (enemy) {
+        enemy_attacks[piece.GetPieceType()] |= attacks;
+      } else {
+        defended |= attacks;
+      }
+    }
+  }
+
+  Threats threats;
+  Bitboard attacked;
+  for (int attacker = 0; attacker < 6; attacker++) {
+    attacked |= enemy_attacks[attacker];
+    Bitboard victims;
+    for (int victim = 0; victim < KING; victim++) {
+      if (piece_evaluations[victim] - piece_evaluations[attacker] >= margin) {
+        victims |= piece_type_bitboards_[victim];
+      }
+    }
+    threats.by_lesser |= enemy_attacks[attacker] & victims;
+  }
+  Bitboard pieces = team_bitboards_[team] & ~piece_type_bitboards_[KING];
+  threats.by_lesser &= pieces;
+  threats.hanging = pieces & attacked & ~defended;
+  return threats;
+}
+
+Bitboard Board::GetAttackersTo(
+    int square, Team team, const Bitboard& occupied) const {
+  const auto& tables = GetBitboardTables();
+  const Bitboard& pieces = team_bitboards_[team];
+  const Bitboard& queens = piece_type_bitboards_[QUEEN];
+
+  Bitboard attackers =
+      (chess::RookAttacks(tables, square, occupied)
+       & (piece_type_bitboards_[ROOK] | queens))
+    | (chess::BishopAttacks(tables, square, occupied)
+       & (piece_type_bitboards_[BISHOP] | queens))
+    | (tables.knight_attacks[square] & piece_type_bitboards_[KNIGHT])
+    | (tables.king_attacks[square] & piece_type_bitboards_[KING]);
+  Bitboard pawns;
+  for (int color = 0; color < 4; ++color) {
+    if (team == NO_TEAM || GetTeam(static_cast<PlayerColor>(color)) == team) {
+      pawns |= tables.pawn_attackers[color][square] & color_bitboards_[color];
+    }
   }
+  attackers |= pawns & piece_type_bitboards_[PAWN];
+  // Pieces that were removed from `occupied` no longer attack.
+  return attackers & pieces & occupied;
 }
 
 size_t Board::GetAttackers2(
     PlacedPiece* buffer, size_t limit,
     Team team, const BoardLocation& location) const {
   assert(limit > 0);
+  if (track_attacks_ && !IsAttackedByTeam(team, location)) {
+    return 0;
+  }
+  if (layout_ == LAYOUT_PADDED_MAILBOX) {
+    return GetAttackersPadded(buffer, limit, team, location);
+  }
   size_t pos = 0;
 
-#define ADD_ATTACKER(row, col, piece) \
-  buffer[pos++] = PlacedPiece(BoardLocation(row, col), piece); \
-  if (pos == limit) { \
-    return limit; \
+#define ADD_ATTACKER(square) \
+  { \
+    BoardLocation loc = BoardLocation::FromSquare(square); \
+    buffer[pos++] = PlacedPiece(loc, GetPiece(loc)); \
+    if (pos == limit) { \
+      return limit; \
+    } \
+  }
+
+  const auto& tables = GetBitboardTables();
+  const int square = location.GetSquare();
+  const Bitboard& occupied = GetOccupied();
+  const Bitboard& pieces = team_bitboards_[team];
+  const Bitboard& queens = piece_type_bitboards_[QUEEN];
+
+  // Rooks & queens, then bishops & queens. Each ray contributes at most its
+  // first blocker, in the same order the mailbox scan used to visit them.
+  constexpr int kSliderDirections[8] = {
+    WEST, EAST, NORTH, SOUTH,
+    NORTH_WEST, NORTH_EAST, SOUTH_WEST, SOUTH_EAST,
+  };
+  const Bitboard orth_sliders = (piece_type_bitboards_[ROOK] | queens) & pieces;
+  const Bitboard diag_sliders =
+    (piece_type_bitboards_[BISHOP] | queens) & pieces;
+  for (int i = 0; i < 8; ++i) {
+    int dir = kSliderDirections[i];
+    const Bitboard& sliders = i < 4 ? orth_sliders : diag_sliders;
+    Bitboard blockers = tables.rays[dir][square] & occupied;
+    if (blockers.Any()) {
+      int blocker = IsPositiveDirection(dir) ? blockers.Lsb() : blockers.Msb();
+      if (sliders.Test(blocker)) {
+        ADD_ATTACKER(blocker);
+      }
+    }
   }
 
-  int loc_row = location.GetRow();
-  int loc_col = location.GetCol();
-  bool no_team = team == NO_TEAM;
-
-  // Rooks & queens
-  for (int do_incr_row = 0; do_incr_row < 2; ++do_incr_row) {
-    for (int pos_incr = 0; pos_incr < 2; ++pos_incr) {
-      int row_incr = do_incr_row ? (pos_incr ? 1 : -1) : 0;
-      int col_incr = do_incr_row ? 0 : (pos_incr ? 1 : -1);
-      int row = loc_row + row_incr;
-      int col = loc_col + col_incr;
-      while (row >= 0 && row < 14 && col >= 0 && col < 14) {
-        const auto piece = GetPiece(row, col);
-        if (piece.Present()) {
-          if ((piece.GetTeam() == team || no_team)
-              && (piece.GetPieceType() == ROOK
-                  || piece.GetPieceType() == QUEEN)) {
-            ADD_ATTACKER(row, col, piece);
-          }
-          break;
-        }
-        row += row_incr;
-        col += col_incr;
-      }
+  // Knights
+  Bitboard knights = tables.knight_attacks[square]
+    & piece_type_bitboards_[KNIGHT] & pieces;
+  while (knights.Any()) {
+    ADD_ATTACKER(knights.PopLsb());
+  }
+
+  // Pawns
+  Bitboard pawns;
+  for (int color = 0; color < 4; ++color) {
+    if (team == NO_TEAM || GetTeam(static_cast<PlayerColor>(color)) == team) {
+      pawns |= tables.pawn_attackers[color][square]
+        & color_bitboards_[color];
     }
   }
+  pawns &= piece_type_bitboards_[PAWN];
+  while (pawns.Any()) {
+    ADD_ATTACKER(pawns.PopLsb());
+  }
 
-  // Bishops & queens
-  for (int pos_row = 0; pos_row < 2; ++pos_row) {
-    int row_incr = pos_row ? 1 : -1;
-    for (int pos_col = 0; pos_col < 2; ++pos_col) {
-      int col_incr = pos_col ? 1 : -1;
-      int row = loc_row + row_incr;
-      int col = loc_col + col_incr;
-      while (IsLegalLocation(row, col)) {
-        const auto piece = GetPiece(row, col);
-        if (piece.Present()) {
-          if ((piece.GetTeam() == team || no_team)
-              && (piece.GetPieceType() == BISHOP
-                  || piece.GetPieceType() == QUEEN)) {
-            ADD_ATTACKER(row, col, piece);
-          }
-          break;
-        }
-        row += row_incr;
-        col += col_incr;
-      }
+  // Kings
+  Bitboard kings = tables.king_attacks[square]
+    & piece_type_bitboards_[KING] & pieces;
+  while (kings.Any()) {
+    ADD_ATTACKER(kings.PopLsb());
+  }
+
+#undef ADD_ATTACKER
+
+  return pos;
+}
+
+size_t Board::GetAttackersPadded(
+    PlacedPiece* buffer, size_t limit,
+    Team team, const BoardLocation& location) const {
+  size_t pos = 0;
+
+#define ADD_ATTACKER(index, piece) \
+  buffer[pos++] = PlacedPiece(FromPadded(index), piece); \
+  if (pos == limit) { \
+    return limit; \
+  }
+
+  const int index = ToPadded(location);
+  const bool no_team = team == NO_TEAM;
+
+  // Rooks & queens, then bishops & queens. Off-board sentinels have no piece
+  // type, so the type test also rejects them.
+  constexpr int kSliderOffsets[8] = {
+    PaddedOffset(0, -1), PaddedOffset(0, 1),
+    PaddedOffset(-1, 0), PaddedOffset(1, 0),
+    PaddedOffset(-1, -1), PaddedOffset(-1, 1),
+    PaddedOffset(1, -1), PaddedOffset(1, 1),
+  };
+  for (int i = 0; i < 8; ++i) {
+    int offset = kSliderOffsets[i];
+    int at = index + offset;
+    while (padded_board_[at].Missing()) {
+      at += offset;
+    }
+    const Piece& piece = padded_board_[at];
+    PieceType piece_type = piece.GetPieceType();
+    if ((piece_type == QUEEN || piece_type == (i < 4 ? ROOK : BISHOP))
+        && (no_team || piece.GetTeam() == team)) {
+      ADD_ATTACKER(at, piece);
     }
   }
 
   // Knights
-  for (int row_less = 0; row_less < 2; ++row_less) {
-    for (int pos_row = 0; pos_row < 2; ++pos_row) {
-      int row = loc_row + (row_less ? (pos_row ? 1 : -1) : (pos_row ? 2: -2));
-      for (int pos_col = 0; pos_col < 2; ++pos_col) {
-        int col = loc_col + (row_less ? (pos_col ? 2: -2): (pos_col ? 1 : -1));
-        if (IsLegalLocation(row, col)) {
-          const auto piece = GetPiece(row, col);
-          if (piece.Present()
-              && (piece.GetTeam() == team || no_team)
-              && piece.GetPieceType() == KNIGHT) {
-            ADD_ATTACKER(row, col, piece);
-          }
-        }
-      }
+  for (int offset : kPaddedKnightOffsets) {
+    const Piece& piece = padded_board_[index + offset];
+    if (piece.Present()
+        && piece.GetPieceType() == KNIGHT
+        && (no_team || piece.GetTeam() == team)) {
+      ADD_ATTACKER(index + offset, piece);
     }
   }
 
-  // Pawns
-  for (int pos_row = 0; pos_row < 2; ++pos_row) {
-    int row = pos_row ? loc_row + 1 : loc_row - 1;
-    if (row >= 0 && row < 14) {
-      for (int pos_col = 0; pos_col < 2; ++pos_col) {
-        int col = pos_col ? loc_col + 1 : loc_col - 1;
-        if (col >= 0 && col < 14) {
-          const auto piece = GetPiece(row, col);
-          if (piece.Present()
-              && (piece.GetTeam() == team || no_team)
-              && piece.GetPieceType() == PAWN) {
-            bool attacks = false;
-            switch (piece.GetColor()) {
-            case RED:
-              if (pos_row) {
-                attacks = true;
-              }
-              break;
-            case BLUE:
-              if (!pos_col) {
-                attacks = true;
-              }
-              break;
-            case YELLOW:
-              if (!pos_row) {
-                attacks = true;
-              }
-              break;
-            case GREEN:
-              if (pos_col) {
-                attacks = true;
-              }
-              break;
-            default:
-              assert(false);
-              break;
-            }
-
-            if (attacks) {
-              ADD_ATTACKER(row, col, piece);
-            }
-
-          }
-        }
-      }
+  // Pawns. Indexed by pawn color and by which diagonal neighbor (NW, NE, SW,
+  // SE) the pawn stands on.
+  constexpr int kPawnOffsets[4] = {
+    PaddedOffset(-1, -1), PaddedOffset(-1, 1),
+    PaddedOffset(1, -1), PaddedOffset(1, 1),
+  };
+  constexpr bool kPawnAttacksFrom[4][4] = {
+    {false, false, true, true},  // RED
+    {true, false, true, false},  // BLUE
+    {true, true, false, false},  // YELLOW
+    {false, true, false, true},  // GREEN
+  };
+  for (int i = 0; i < 4; ++i) {
+    const Piece& piece = padded_board_[index + kPawnOffsets[i]];
+    if (piece.Present()
+        && piece.GetPieceType() == PAWN
+        && (no_team || piece.GetTeam() == team)
+        && kPawnAttacksFrom[piece.GetColor()][i]) {
+      ADD_ATTACKER(index + kPawnOffsets[i], piece);
     }
   }
 
   // Kings
-  for (int delta_row = -1; delta_row < 2; ++delta_row) {
-    int row = loc_row + delta_row;
-    for (int delta_col = -1; delta_col < 2; ++delta_col) {
-      if (delta_row == 0 && delta_col == 0) {
-        continue;
-      }
-      int col = loc_col + delta_col;
-      if (IsLegalLocation(row, col)) {
-        const auto piece = GetPiece(row, col);
-        if (piece.Present()
-            && (piece.GetTeam() == team || no_team)
-            && piece.GetPieceType() == KING) {
-          ADD_ATTACKER(row, col, piece);
-        }
-      }
+  for (int offset : kPaddedKingOffsets) {
+    const Piece& piece = padded_board_[index + offset];
+    if (piece.Present()
+        && piece.GetPieceType() == KING
+        && (no_team || piece.GetTeam() == team)) {
+      ADD_ATTACKER(index + offset, piece);
     }
   }
 
@@ -768,12 +803,19 @@ size_t Board::GetAttackers2(
 }
 
 bool Board::IsAttackedByTeam(Team team, const BoardLocation& location) const {
-  PlacedPiece attackers[1];
-  size_t pos = GetAttackers2(attackers, 1, team, location);
-  return pos > 0;
-
-  // auto attackers = GetAttackers(team, location, /*return_early=*/true);
-  // return attackers.size() > 0;
+  if (track_attacks_) {
+    int square = location.GetSquare();
+    if (team == NO_TEAM) {
+      return attack_counts_[RED_YELLOW][square] > 0
+          || attack_counts_[BLUE_GREEN][square] > 0;
+    }
+    return attack_counts_[team][square] > 0;
+  }
+  if (layout_ == LAYOUT_PADDED_MAILBOX) {
+    PlacedPiece attackers[1];
+    return GetAttackersPadded(attackers, 1, team, location) > 0;
+  }
+  return GetAttackersTo(location.GetSquare(), team, GetOccupied()).Any();
 }
 
 bool Board::IsOnPathBetween(
@@ -792,49 +834,34 @@ bool Board::DiscoversCheck(
     const BoardLocation& move_from,
     const BoardLocation& move_to,
     Team attacking_team) const {
-  int delta_row = move_from.GetRow() - king_location.GetRow();
-  int delta_col = move_from.GetCol() - king_location.GetCol();
-  if (std::abs(delta_row) != std::abs(delta_col)
-      && delta_row != 0
-      && delta_col != 0) {
+  const auto& tables = GetBitboardTables();
+  int king_square = king_location.GetSquare();
+  int dir = tables.direction_to[king_square][move_from.GetSquare()];
+  if (dir < 0) {
     return false;
   }
 
-  int incr_col = delta_col == 0 ? 0 : delta_col > 0 ? 1 : -1;
-  int incr_row = delta_row == 0 ? 0 : delta_row > 0 ? 1 : -1;
-  int row = king_location.GetRow() + incr_row;
-  int col = king_location.GetCol() + incr_col;
-  while (IsLegalLocation(row, col)) {
-    if (row != move_from.GetRow() || col != move_from.GetCol()) {
-      if (row == move_to.GetRow() && col == move_to.GetCol()) {
-        return false;
-      }
-      const auto piece = GetPiece(row, col);
-      if (piece.Present()) {
-        if (piece.GetTeam() == attacking_team) {
-          if (delta_row == 0 || delta_col == 0) {
-            if (piece.GetPieceType() == QUEEN
-                || piece.GetPieceType() == ROOK) {
-              return true;
-            }
-          } else {
-            if (piece.GetPieceType() == QUEEN
-                || piece.GetPieceType() == BISHOP) {
-              return true;
-            }
-          }
-        }
-        break;
-      }
+  PieceType slider = IsDiagonalDirection(dir) ? BISHOP : ROOK;
+  for (int i = 0; i < tables.ray_length[dir][king_square]; ++i) {
+    BoardLocation loc = BoardLocation::FromSquare(
+        tables.ray_squares[dir][king_square][i]);
+    if (loc == move_from) {
+      continue;
+    }
+    if (loc == move_to) {
+      return false;
+    }
+    const auto piece = GetPiece(loc);
+    if (piece.Present()) {
+      return piece.GetTeam() == attacking_team
+        && (piece.GetPieceType() == QUEEN || piece.GetPieceType() == slider);
     }
-
-    row += incr_row;
-    col += incr_col;
   }
   return false;
 }
 
-size_t Board::GetPseudoLegalMoves2(Move* buffer, size_t limit) {
+size_t Board::GetPseudoLegalMoves2(Move* buffer, size_t limit,
+                                   MoveGenType type) {
   MoveBuffer move_buffer;
   move_buffer.buffer = buffer;
   move_buffer.limit = limit;
@@ -849,22 +876,22 @@ size_t Board::GetPseudoLegalMoves2(Move* buffer, size_t limit) {
     const auto& piece = placed_piece.GetPiece();
     switch (piece.GetPieceType()) {
       case PAWN:
-        GetPawnMoves2(move_buffer, location, piece);
+        GetPawnMoves2(move_buffer, location, piece, type);
         break;
       case KNIGHT:
-        GetKnightMoves2(move_buffer, location, piece);
+        GetKnightMoves2(move_buffer, location, piece, type);
         break;
       case BISHOP:
-        GetBishopMoves2(move_buffer, location, piece);
+        GetBishopMoves2(move_buffer, location, piece, type);
         break;
       case ROOK:
-        GetRookMoves2(move_buffer, location, piece);
+        GetRookMoves2(move_buffer, location, piece, type);
         break;
       case QUEEN:
-        GetQueenMoves2(move_buffer, location, piece);
+        GetQueenMoves2(move_buffer, location, piece, type);
         break;
       case KING:
-        GetKingMoves2(move_buffer, location, piece);
+        GetKingMoves2(move_buffer, location, piece, type);
         king_location = location;
         break;
       default:
@@ -875,6 +902,249 @@ size_t Board::GetPseudoLegalMoves2(Move* buffer, size_t limit) {
   return move_buffer.pos;
 }
 
+MoveCounts Board::CountPseudoLegalMoves(
+    PlayerColor color, const int piece_evaluations[6],
+    int threat_threshold, const Bitboard& piece_move_squares) const {
+  MoveCounts counts;
+  BoardLocation king_location = GetKingLocation(color);
+  if (!king_location.Present()) {
+    return counts;
+  }
+
+  const auto& tables = GetBitboardTables();
+  const Bitboard& occupied = GetOccupied();
+  const Team team = GetTeam(color);
+  const Bitboard& enemies = team_bitboards_[OtherTeam(team)];
+  const Bitboard& promotion = tables.pawn_promotion[color];
+
+  // Enemy pieces that a piece of each type threatens if it can capture them.
+  Bitboard threatened[6];
+  for (int attacker = 0; attacker < 6; attacker++) {
+    for (int victim = 0; victim < 6; victim++) {
+      if (piece_evaluations[victim] - piece_evaluations[attacker]
+          >= threat_threshold) {
+        threatened[attacker] |= piece_type_bitboards_[victim];
+      }
+    }
+    threatened[attacker] &= enemies;
+  }
+
+  const PieceList& pieces = piece_list_[color];
+  for (size_t i = 0; i < pieces.size(); i++) {
+    const auto& placed_piece = pieces[i];
+    const auto& piece = placed_piece.GetPiece();
+    int square = placed_piece.GetLocation().GetSquare();
+    PieceType piece_type = piece.GetPieceType();
+
+    if (piece_type != PAWN) {
+      Bitboard targets = GetAttacks(piece, square, occupied)
+        & ~team_bitboards_[team];
+      counts.num_moves += targets.Count();
+      counts.piece_moves[i] = (targets & piece_move_squares).Count();
+      Bitboard threats = targets & threatened[piece_type];
+      if (threats.Any()) {
+        counts.num_threats += threats.Count();
+      }
+      if (piece_type == KING) {
+        Move castling_moves[2];
+        MoveBuffer move_buffer;
+        move_buffer.buffer = castling_moves;
+        move_buffer.limit = 2;
+        GetCastlingMoves2(move_buffer, placed_piece.GetLocation(), piece);
+        counts.num_moves += move_buffer.pos;
+      }
+      continue;
+    }
+
+    // Each pawn move onto a promotion square is made once per piece type.
+    int push = tables.pawn_push[color][square];
+    if (push != kNumSquares) {
+      const Piece& other_piece = location_to_piece_[push / 14][push % 14];
+      if (other_piece.Missing()) {
+        counts.num_moves += promotion.Test(push) ? 4 : 1;
+        int double_push = tables.pawn_double_push[color][square];
+        if (double_push != kNumSquares && !occupied.Test(double_push)) {
+          counts.num_moves += promotion.Test(double_push) ? 4 : 1;
+        }
+      } else {
+        BoardLocation enpassant_to = GetEnpassantTarget(
+            piece, BoardLocation::FromSquare(push), other_piece);
+        if (enpassant_to.Present()) {
+          const Piece& existing = GetPiece(enpassant_to);
+          if (existing.Missing() || existing.GetTeam() != team) {
+            int multiplicity = promotion.Test(enpassant_to.GetSquare())
+              ? 4 : 1;
+            counts.num_moves += multiplicity;
+            PieceType victim = existing.Present()
+              ? existing.GetPieceType() : PAWN;
+            if (piece_evaluations[victim] - piece_evaluations[PAWN]
+                >= threat_threshold) {
+              counts.num_threats += multiplicity;
+            }
+          }
+        }
+      }
+    }
+
+    Bitboard captures = tables.pawn_attacks[color][square] & enemies;
+    if (captures.Any()) {
+      Bitboard threats = captures & threatened[PAWN];
+      counts.num_moves += captures.Count();
+      counts.num_threats += threats.Count();
+      Bitboard promotions = captures & promotion;
+      if (promotions.Any()) {
+        counts.num_moves += 3 * promotions.Count();
+        counts.num_threats += 3 * (threats & promotion).Count();
+      }
+    }
+  }
+
+  return counts;
+}
+
+size_t Board::GetLegalMoves(Move* buffer, size_t limit) {
+  return FilterLegalMoves(buffer, GetPseudoLegalMoves2(buffer, limit));
+}
+
+size_t Board::GetCaptureMoves(Move* buffer, size_t limit) {
+  return FilterLegalMoves(
+      buffer, GetPseudoLegalMoves2(buffer, limit, GEN_CAPTURES));
+}
+
+size_t Board::GetQuietMoves(Move* buffer, size_t limit) {
+  return FilterLegalMoves(
+      buffer, GetPseudoLegalMoves2(buffer, limit, GEN_QUIETS));
+}
+
+std::optional<Move> Board::UnpackMove(PackedMove packed) const {
+  if (!packed.Present()) {
+    return std::nullopt;
+  }
+  BoardLocation from = BoardLocation::FromSquare(packed.From());
+  const Piece piece = GetPiece(from);
+  if (piece.Missing() || piece.GetColor() != turn_.GetColor()) {
+    return std::nullopt;
+  }
+
+  // Enough for a queen in the middle of the board.
+  constexpr size_t kMaxPieceMoves = 64;
+  Move moves[kMaxPieceMoves];
+  MoveBuffer move_buffer;
+  move_buffer.buffer = moves;
+  move_buffer.limit = kMaxPieceMoves;
+  switch (piece.GetPieceType()) {
+    case PAWN:
+      GetPawnMoves2(move_buffer, from, piece, GEN_ALL);
+      break;
+    case KNIGHT:
+      GetKnightMoves2(move_buffer, from, piece, GEN_ALL);
+      break;
+    case BISHOP:
+      GetBishopMoves2(move_buffer, from, piece, GEN_ALL);
+      break;
+    case ROOK:
+      GetRookMoves2(move_buffer, from, piece, GEN_ALL);
+      break;
+    case QUEEN:
+      GetQueenMoves2(move_buffer, from, piece, GEN_ALL);
+      break;
+    case KING:
+      GetKingMoves2(move_buffer, from, piece, GEN_ALL);
+      break;
+    default:
+      assert(false);
+  }
+
+  for (size_t i = 0; i < move_buffer.pos; i++) {
+    if (packed == moves[i]) {
+      return moves[i];
+    }
+  }
+  return std::nullopt;
+}
+
+size_t Board::FilterLegalMoves(Move* buffer, size_t num_moves) {
+  if (num_moves == 0) {
+    return 0;
+  }
+
+  const auto& tables = GetBitboardTables();
+  const Player player = turn_;
+  const PlayerColor color = player.GetColor();
+  const Team enemy_team = OtherTeam(player.GetTeam());
+  const int king_square = GetKingLocation(color).GetSquare();
+  const Bitboard& occupied = GetOccupied();
+  const Bitboard& enemies = team_bitboards_[enemy_team];
+
+  // Squares that a move by any other piece must land on: anywhere when not
+  // in check, the checker or a square between it and the king in single
+  // check, and none in double check.
+  Bitboard checkers = GetAttackersTo(king_square, enemy_team, occupied);
+  Bitboard evasion_mask = tables.legal;
+  if (checkers.Any()) {
+    if (checkers.Count() > 1) {
+      evasion_mask = Bitboard();
+    } else {
+      int dir = tables.direction_to[king_square][checkers.Lsb()];
+      evasion_mask = dir >= 0
+        ? RayAttacks(tables, dir, king_square, occupied) : checkers;
+    }
+  }
+
+  // A piece of the mover's color is pinned if it is the only piece between
+  // the king and an enemy slider. It may only move along the pin ray.
+  Bitboard pinned;
+  Bitboard pin_rays[kNumDirections];
+  for (int dir = 0; dir < kNumDirections; dir++) {
+    Bitboard blockers = RayAttacks(tables, dir, king_square, occupied)
+      & occupied;
+    if (blockers.Empty()
+        || (blockers & color_bitboards_[color]).Empty()) {
+      continue;
+    }
+    int blocker = blockers.Lsb();
+    Bitboard ray = RayAttacks(tables, dir, king_square,
+                              occupied ^ Bitboard::FromSquare(blocker));
+    Bitboard sliders = piece_type_bitboards_[QUEEN]
+      | piece_type_bitboards_[IsDiagonalDirection(dir) ? BISHOP : ROOK];
+    if ((ray & occupied & enemies & sliders).Any()) {
+      pinned.Set(blocker);
+      pin_rays[dir] = ray;
+    }
+  }
+
+  size_t num_legal = 0;
+  for (size_t i = 0; i < num_moves; i++) {
+    const Move& move = buffer[i];
+    int from = move.From().GetSquare();
+    int to = move.To().GetSquare();
+
+    bool legal;
+    const Piece capture = move.GetStandardCapture();
+    if (capture.Present() && capture.GetPieceType() == KING) {
+      legal = true;
+    } else if (move.GetRookMove().Present()
+               || move.GetEnpassantLocation().Present()) {
+      MakeMove(move);
+      legal = !IsKingInCheck(player);
+      UndoMove();
+    } else if (from == king_square) {
+      Bitboard occupied_after = occupied;
+      occupied_after.Clear(from);
+      legal = GetAttackersTo(to, enemy_team, occupied_after).Empty();
+    } else {
+      legal = evasion_mask.Test(to)
+        && (!pinned.Test(from)
+            || pin_rays[tables.direction_to[king_square][from]].Test(to));
+    }
+
+    if (legal) {
+      buffer[num_legal++] = move;
+    }
+  }
+  return num_legal;
+}
+
 GameResult Board::GetGameResult() {
   if (!GetKingLocation(turn_.GetColor()).Present()) {
     // other team won
@@ -882,20 +1152,14 @@ GameResult Board::GetGameResult() {
   }
   Player player = turn_;
 
-  size_t num_moves = GetPseudoLegalMoves2(move_buffer_2_, move_buffer_size_);
-  for (size_t i = 0; i < num_moves; i++) {
-    const auto& move = move_buffer_2_[i];
-    MakeMove(move);
-    GameResult king_capture_result = CheckWasLastMoveKingCapture();
-    if (king_capture_result != IN_PROGRESS) {
-      UndoMove();
-      return king_capture_result;
-    }
-    bool legal = !IsKingInCheck(player);
-    UndoMove();
-    if (legal) {
-      return IN_PROGRESS;
+  Move moves[kMaxScratchMoves];
+  size_t num_moves = GetLegalMoves(moves, kMaxScratchMoves);
+  if (num_moves > 0) {
+    const auto capture = moves[0].GetCapturePiece();
+    if (capture.Present() && capture.GetPieceType() == KING) {
+      return capture.GetTeam() == RED_YELLOW ? WIN_BG : WIN_RY;
     }
+    return IN_PROGRESS;
   }
   if (!IsKingInCheck(player)) {
     return STALEMATE;
@@ -927,8 +1191,8 @@ bool Board::IsKingInCheck(Team team) const {
 
 GameResult Board::CheckWasLastMoveKingCapture() const {
   // King captured last move
-  if (!moves_.empty()) {
-    const auto& last_move = moves_.back();
+  if (num_plies_ > 0) {
+    const auto& last_move = GetUndoState(num_plies_ - 1).move;
     const auto capture = last_move.GetCapturePiece();
     if (capture.Present() && capture.GetPieceType() == KING) {
       return capture.GetTeam() == RED_YELLOW ? WIN_BG : WIN_RY;
@@ -940,10 +1204,17 @@ GameResult Board::CheckWasLastMoveKingCapture() const {
 void Board::SetPiece(
     const BoardLocation& location,
     const Piece& piece) {
+  if (track_attacks_) {
+    int square = location.GetSquare();
+    UpdateSliderRaysThrough(square, -1);
+    AddAttackCounts(piece.GetTeam(),
+        GetAttacks(piece, square, GetOccupied()), 1);
+  }
   location_to_piece_[location.GetRow()][location.GetCol()] = piece;
-  // Add to piece_list_
-  piece_list_[piece.GetColor()].emplace_back(location, piece);
+  padded_board_[ToPadded(location)] = piece;
+  AddToPieceList(location, piece);
   UpdatePieceHash(piece, location);
+  UpdatePieceBitboards(piece, location);
   // Update king location
   if (piece.GetPieceType() == KING) {
     king_locations_[piece.GetColor()] = location;
@@ -956,22 +1227,27 @@ void Board::SetPiece(
     piece_evaluation_ -= piece_eval;
   }
   player_piece_evaluations_[piece.GetColor()] += piece_eval;
+  if (piece_square_table_ != nullptr) {
+    piece_square_evaluations_[piece.GetColor()] += (*piece_square_table_)
+      [piece.GetColor()][piece.GetPieceType()]
+      [location.GetRow()][location.GetCol()];
+  }
 }
 
 void Board::RemovePiece(const BoardLocation& location) {
   const auto piece = GetPiece(location);
   assert(piece.Present());
   UpdatePieceHash(piece, location);
+  UpdatePieceBitboards(piece, location);
   location_to_piece_[location.GetRow()][location.GetCol()] = Piece();
-  auto& placed_pieces = piece_list_[piece.GetColor()];
-  for (auto it = placed_pieces.begin(); it != placed_pieces.end();) {
-    const auto& placed_piece = *it;
-    if (placed_piece.GetLocation() == location) {
-      placed_pieces.erase(it);
-      break;
-    }
-    ++it;
-  }
+  padded_board_[ToPadded(location)] = Piece();
+  if (track_attacks_) {
+    int square = location.GetSquare();
+    AddAttackCounts(piece.GetTeam(),
+        GetAttacks(piece, square, GetOccupied()), -1);
+    UpdateSliderRaysThrough(square, 1);
+  }
+  RemoveFromPieceList(location, piece.GetColor());
   // Update king location
   if (piece.GetPieceType() == KING) {
     king_locations_[piece.GetColor()] = BoardLocation::kNoLocation;
@@ -984,6 +1260,82 @@ void Board::RemovePiece(const BoardLocation& location) {
     piece_evaluation_ += piece_eval;
   }
   player_piece_evaluations_[piece.GetColor()] -= piece_eval;
+  if (piece_square_table_ != nullptr) {
+    piece_square_evaluations_[piece.GetColor()] -= (*piece_square_table_)
+      [piece.GetColor()][piece.GetPieceType()]
+      [location.GetRow()][location.GetCol()];
+  }
+}
+
+void Board::AddToPieceList(
+    const BoardLocation& location, const Piece& piece) {
+  auto& pieces = piece_list_[piece.GetColor()];
+  if (pieces.size_ >= PieceList::kCapacity) {
+    std::cout << "Piece list overflow" << std::endl;
+    abort();
+  }
+  piece_slot_[location.GetSquare()] = pieces.size_;
+  pieces.pieces_[pieces.size_++] = PlacedPiece(location, piece);
+}
+
+void Board::RemoveFromPieceList(
+    const BoardLocation& location, PlayerColor color) {
+  auto& pieces = piece_list_[color];
+  int slot = piece_slot_[location.GetSquare()];
+  assert(pieces.pieces_[slot].GetLocation() == location);
+  const PlacedPiece& last = pieces.pieces_[--pieces.size_];
+  pieces.pieces_[slot] = last;
+  piece_slot_[last.GetLocation().GetSquare()] = slot;
+}
+
+void Board::EnableAttackMaps(bool enable) {
+  track_attacks_ = enable;
+  if (enable) {
+    RecomputeAttackMaps();
+  }
+}
+
+void Board::RecomputeAttackMaps() {
+  std::memset(attack_counts_, 0, sizeof(attack_counts_));
+  const Bitboard& occupied = GetOccupied();
+  Bitboard pieces = occupied;
+  while (pieces.Any()) {
+    int square = pieces.PopLsb();
+    const auto& piece = GetPiece(BoardLocation::FromSquare(square));
+    AddAttackCounts(piece.GetTeam(), GetAttacks(piece, square, occupied), 1);
+  }
+}
+
+void Board::AddAttackCounts(Team team, Bitboard squares, int delta) {
+  uint8_t* counts = attack_counts_[team];
+  while (squares.Any()) {
+    counts[squares.PopLsb()] += delta;
+  }
+}
+
+// Called when `square` becomes occupied (delta = -1) or empty (delta = 1):
+// every slider whose ray reaches the square loses or gains the part of the
+// ray beyond it. The square itself must be empty in the occupancy bitboards.
+void Board::UpdateSliderRaysThrough(int square, int delta) {
+  const auto& tables = GetBitboardTables();
+  Bitboard occupied = GetOccupied();
+  occupied.Clear(square);
+  for (int dir = 0; dir < kNumDirections; dir++) {
+    int behind_dir = kNumDirections - 1 - dir;
+    Bitboard behind = tables.rays[behind_dir][square] & occupied;
+    if (behind.Empty()) {
+      continue;
+    }
+    int slider_square = IsPositiveDirection(behind_dir)
+      ? behind.Lsb() : behind.Msb();
+    const auto& slider = GetPiece(BoardLocation::FromSquare(slider_square));
+    PieceType piece_type = slider.GetPieceType();
+    if (piece_type == QUEEN
+        || piece_type == (IsDiagonalDirection(dir) ? BISHOP : ROOK)) {
+      AddAttackCounts(slider.GetTeam(),
+          RayAttacks(tables, dir, square, occupied), delta);
+    }
+  }
 }
 
 void Board::InitializeHash() {
@@ -1003,10 +1355,20 @@ void Board::MakeMove(const Move& move) {
   // 4. Promotion
   // 5. Castling (rights, rook move)
 
+  if (num_plies_ >= kInlineUndoPlies
+      && size_t(num_plies_ - kInlineUndoPlies) >= undo_overflow_.size()) {
+    undo_overflow_.emplace_back();
+  }
+  UndoState& undo = GetUndoState(num_plies_++);
+  undo.move = move;
+  undo.castling_rights = castling_rights_[turn_.GetColor()];
+  undo.hash_key = hash_key_;
+
   const auto piece = GetPiece(move.From());
 
   // Capture
   const auto standard_capture = GetPiece(move.To());
+  undo.captured = standard_capture;
   if (standard_capture.Present()) {
     RemovePiece(move.To());
   }
@@ -1047,10 +1409,21 @@ void Board::MakeMove(const Move& move) {
       SetPiece(rook_move.To(), rook);
     }
 
-    // Castling: rights update
-    const auto castling_rights = move.GetCastlingRights();
-    if (castling_rights.Present()) {
-      castling_rights_[turn_.GetColor()] = castling_rights;
+    // Castling: rights update. A king move loses both rights, and a move
+    // from a rook's starting square loses that side's.
+    auto& castling_rights = castling_rights_[turn_.GetColor()];
+    PieceType piece_type = piece.GetPieceType();
+    if (piece_type == KING) {
+      castling_rights = CastlingRights(false, false);
+    } else if ((piece_type == ROOK || piece_type == QUEEN)
+               && (castling_rights.Kingside() || castling_rights.Queenside())) {
+      std::optional<CastlingType> castling_type = GetRookLocationType(
+          turn_, move.From());
+      if (castling_type == KINGSIDE) {
+        castling_rights = CastlingRights(false, castling_rights.Queenside());
+      } else if (castling_type == QUEENSIDE) {
+        castling_rights = CastlingRights(castling_rights.Kingside(), false);
+      }
     }
   }
 
@@ -1059,7 +1432,6 @@ void Board::MakeMove(const Move& move) {
   UpdateTurnHash((t+1)%4);
 
   turn_ = GetNextPlayer(turn_);
-  moves_.push_back(move);
 }
 
 void Board::UndoMove() {
@@ -1070,8 +1442,9 @@ void Board::UndoMove() {
   // 4. Promotion
   // 5. Castling (rights, rook move)
 
-  assert(!moves_.empty());
-  const Move& move = moves_.back();
+  assert(num_plies_ > 0);
+  const UndoState& undo = GetUndoState(--num_plies_);
+  const Move& move = undo.move;
   Player turn_before = GetPreviousPlayer(turn_);
 
   const BoardLocation& to = move.To();
@@ -1095,9 +1468,8 @@ void Board::UndoMove() {
   }
 
   // Place back captured pieces
-  const auto standard_capture = move.GetStandardCapture();
-  if (standard_capture.Present()) {
-    SetPiece(to, standard_capture);
+  if (undo.captured.Present()) {
+    SetPiece(to, undo.captured);
   }
 
   // Place back en-passant pawns
@@ -1113,18 +1485,20 @@ void Board::UndoMove() {
       SetPiece(rook_move.From(), Piece(turn_before.GetColor(), ROOK));
     }
 
-    // Castling: rights update
-    const auto initial_castling_rights = move.GetInitialCastlingRights();
-    if (initial_castling_rights.Present()) {
-      castling_rights_[turn_before.GetColor()] = initial_castling_rights;
-    }
   }
 
+  castling_rights_[turn_before.GetColor()] = undo.castling_rights;
   turn_ = turn_before;
-  moves_.pop_back();
-  int t = static_cast<int>(turn_.GetColor());
-  UpdateTurnHash(t);
-  UpdateTurnHash((t+1)%4);
+  hash_key_ = undo.hash_key;
+}
+
+std::vector<Move> Board::Moves() const {
+  std::vector<Move> moves;
+  moves.reserve(num_plies_);
+  for (int i = 0; i < num_plies_; i++) {
+    moves.push_back(GetUndoState(i).move);
+  }
+  return moves;
 }
 
 BoardLocation Board::GetKingLocation(PlayerColor color) const {
@@ -1148,11 +1522,28 @@ int Board::PieceEvaluation(PlayerColor color) const {
   return player_piece_evaluations_[color];
 }
 
+void Board::SetPieceSquareTable(const PieceSquareTable* table) {
+  piece_square_table_ = table;
+  for (int color = 0; color < 4; color++) {
+    piece_square_evaluations_[color] = 0;
+    if (table == nullptr) {
+      continue;
+    }
+    for (const auto& placed_piece : piece_list_[color]) {
+      const auto& location = placed_piece.GetLocation();
+      piece_square_evaluations_[color] += (*table)[color]
+        [placed_piece.GetPiece().GetPieceType()]
+        [location.GetRow()][location.GetCol()];
+    }
+  }
+}
+
 int Board::MobilityEvaluation(const Player& player) {
   Player turn = turn_;
   turn_ = player;
   int mobility = 0;
-  size_t num_moves = GetPseudoLegalMoves2(move_buffer_2_, move_buffer_size_);
+  Move moves[kMaxScratchMoves];
+  size_t num_moves = GetPseudoLegalMoves2(moves, kMaxScratchMoves);
   int player_mobility = (int) num_moves;
 
   if (player.GetTeam() == RED_YELLOW) {
@@ -1171,9 +1562,10 @@ int Board::MobilityEvaluation() {
   Player turn = turn_;
 
   int mobility = 0;
+  Move moves[kMaxScratchMoves];
   for (int player_color = 0; player_color < 4; ++player_color) {
     turn_ = Player(static_cast<PlayerColor>(player_color));
-    size_t num_moves = GetPseudoLegalMoves2(move_buffer_2_, move_buffer_size_);
+    size_t num_moves = GetPseudoLegalMoves2(moves, kMaxScratchMoves);
     int player_mobility = (int) num_moves;
 
     if (turn_.GetTeam() == RED_YELLOW) {
@@ -1193,56 +1585,109 @@ Board::Board(
     Player turn,
     std::unordered_map<BoardLocation, Piece> location_to_piece,
     std::optional<std::unordered_map<Player, CastlingRights>> castling_rights,
-    std::optional<EnpassantInitialization> enp)
-  : turn_(std::move(turn))
-    {
-
+    std::optional<EnpassantInitialization> enp) {
+  CastlingRights rights[4];
   for (int color = 0; color < 4; color++) {
-    castling_rights_[color] = CastlingRights(false, false);
+    rights[color] = CastlingRights(false, false);
     if (castling_rights.has_value()) {
       auto& cr = *castling_rights;
       Player pl(static_cast<PlayerColor>(color));
       auto it = cr.find(pl);
       if (it != cr.end()) {
-        castling_rights_[color] = it->second;
+        rights[color] = it->second;
       }
     }
   }
-  if (enp.has_value()) {
-    enp_ = std::move(*enp);
+
+  Piece pieces[14][14];
+  for (const auto& it : location_to_piece) {
+    const auto& location = it.first;
+    pieces[location.GetRow()][location.GetCol()] = it.second;
+  }
+
+  SetPosition(turn, pieces, rights,
+              enp.has_value() ? *enp : EnpassantInitialization());
+}
+
+Board::Board(const Board& other)
+  : BoardState(other), undo_overflow_(other.undo_overflow_) {
+  std::copy(other.undo_stack_,
+            other.undo_stack_ + std::min(num_plies_, kInlineUndoPlies),
+            undo_stack_);
+}
+
+Board& Board::operator=(const Board& other) {
+  if (this != &other) {
+    BoardState::operator=(other);
+    std::copy(other.undo_stack_,
+              other.undo_stack_ + std::min(num_plies_, kInlineUndoPlies),
+              undo_stack_);
+    undo_overflow_ = other.undo_overflow_;
+  }
+  return *this;
+}
+
+void Board::SetPosition(
+    Player turn,
+    const Piece (&pieces)[14][14],
+    const CastlingRights (&castling_rights)[4],
+    const EnpassantInitialization& enp) {
+  turn_ = turn;
+  for (int color = 0; color < 4; color++) {
+    castling_rights_[color] = castling_rights[color];
   }
-  move_buffer_.reserve(1000);
+  enp_ = enp;
+  num_plies_ = 0;
+  undo_overflow_.clear();
 
+  for (int i = 0; i < kPaddedSquares; ++i) {
+    padded_board_[i] = Piece::OffBoard();
+  }
   for (int i = 0; i < 14; ++i) {
     for (int j = 0; j < 14; ++j) {
-      locations_[i][j] = BoardLocation(i, j);
       location_to_piece_[i][j] = Piece();
+      if (IsLegalLocation(i, j)) {
+        padded_board_[PaddedIndex(i, j)] = Piece();
+      }
     }
   }
 
   for (int i = 0; i < 4; i++) {
-    piece_list_.push_back(std::vector<PlacedPiece>());
-    piece_list_[i].reserve(16);
     king_locations_[i] = BoardLocation::kNoLocation;
+    piece_list_[i].size_ = 0;
+    player_piece_evaluations_[i] = 0;
+    color_bitboards_[i] = Bitboard();
   }
+  for (auto& bitboard : team_bitboards_) {
+    bitboard = Bitboard();
+  }
+  for (auto& bitboard : piece_type_bitboards_) {
+    bitboard = Bitboard();
+  }
+  piece_evaluation_ = 0;
 
-  for (const auto& it : location_to_piece) {
-    const auto& location = it.first;
-    const auto& piece = it.second;
-    PlayerColor color = piece.GetColor();
-    location_to_piece_[location.GetRow()][location.GetCol()] = piece;
-    piece_list_[piece.GetColor()].push_back(PlacedPiece(
-          locations_[location.GetRow()][location.GetCol()],
-          piece));
-    PieceType piece_type = piece.GetPieceType();
-    if (piece.GetTeam() == RED_YELLOW) {
-      piece_evaluation_ += kPieceEvaluations[static_cast<int>(piece_type)];
-    } else {
-      piece_evaluation_ -= kPieceEvaluations[static_cast<int>(piece_type)];
-    }
-    player_piece_evaluations_[piece.GetColor()] += kPieceEvaluations[static_cast<int>(piece_type)];
-    if (piece.GetPieceType() == KING) {
-      king_locations_[color] = location;
+  for (int row = 0; row < 14; row++) {
+    for (int col = 0; col < 14; col++) {
+      const Piece& piece = pieces[row][col];
+      if (!piece.Present()) {
+        continue;
+      }
+      BoardLocation location(row, col);
+      PlayerColor color = piece.GetColor();
+      location_to_piece_[row][col] = piece;
+      padded_board_[ToPadded(location)] = piece;
+      AddToPieceList(location, piece);
+      PieceType piece_type = piece.GetPieceType();
+      if (piece.GetTeam() == RED_YELLOW) {
+        piece_evaluation_ += kPieceEvaluations[static_cast<int>(piece_type)];
+      } else {
+        piece_evaluation_ -= kPieceEvaluations[static_cast<int>(piece_type)];
+      }
+      player_piece_evaluations_[piece.GetColor()] += kPieceEvaluations[static_cast<int>(piece_type)];
+      UpdatePieceBitboards(piece, location);
+      if (piece.GetPieceType() == KING) {
+        king_locations_[color] = location;
+      }
     }
   }
 
@@ -1265,23 +1710,17 @@ Board::Board(
 
   for (auto& placed_pieces : piece_list_) {
     std::sort(placed_pieces.begin(), placed_pieces.end(), customLess);
-  }
-
-  // Initialize hashes for each piece at each location, and each turn
-  std::srand(958829);
-  for (int color = 0; color < 4; color++) {
-    turn_hashes_[color] = rand64();
-  }
-  for (int color = 0; color < 4; color++) {
-    for (int piece_type = 0; piece_type < 6; piece_type++) {
-      for (int row = 0; row < 14; row++) {
-        for (int col = 0; col < 14; col++) {
-          piece_hashes_[color][piece_type][row][col] = rand64();
-        }
-      }
+    for (size_t slot = 0; slot < placed_pieces.size(); slot++) {
+      piece_slot_[placed_pieces[slot].GetLocation().GetSquare()] = slot;
     }
   }
 
+  SetPieceSquareTable(piece_square_table_);
+  if (track_attacks_) {
+    RecomputeAttackMaps();
+  }
+  hash_key_ = 0;
+  pawn_key_ = 0;
   InitializeHash();
 }
 
@@ -1482,13 +1921,13 @@ std::ostream& operator<<(
   os << "Turn: " << board.turn_ << std::endl;
 
   os << "All moves: " << std::endl;
-  for (const auto& move : board.moves_) {
-    os << move << std::endl;
+  for (int i = 0; i < board.num_plies_; i++) {
+    os << board.GetUndoState(i).move << std::endl;
   }
   return os;
 }
 
-const CastlingRights& Board::GetCastlingRights(const Player& player) {
+const CastlingRights& Board::GetCastlingRights(const Player& player) const {
   return castling_rights_[player.GetColor()];
 }
 
@@ -1549,46 +1988,105 @@ std::string Move::PrettyStr() const {
   return s;
 }
 
-bool Board::DeliversCheck(const Move& move) {
-  int color = GetTurn().GetColor();
-  Piece piece = GetPiece(move.From());
-
-  bool checks = false;
+CheckInfo Board::GetCheckInfo() const {
+  const auto& tables = GetBitboardTables();
+  const PlayerColor color = turn_.GetColor();
+  const Bitboard& occupied = GetOccupied();
+  const Bitboard& team_pieces = team_bitboards_[turn_.GetTeam()];
 
-  for (int add = 1; add < 4; add += 2) {
-    int other = (color + add) % 4;
-    auto king_loc = GetKingLocation(static_cast<PlayerColor>(other));
-    if (king_loc.Present()) {
-      if (king_loc == move.To()) {
-        checks = true;
-        break;
+  CheckInfo check_info;
+  for (int i = 0; i < 2; i++) {
+    auto king_loc = GetKingLocation(
+        static_cast<PlayerColor>((color + 2 * i + 1) % 4));
+    if (!king_loc.Present()) {
+      continue;
+    }
+    int king_square = king_loc.GetSquare();
+    check_info.king_squares[i] = king_square;
+
+    Bitboard* check_squares = check_info.check_squares[i];
+    check_squares[PAWN] = tables.pawn_attackers[color][king_square];
+    check_squares[KNIGHT] = tables.knight_attacks[king_square];
+    check_squares[BISHOP] = chess::BishopAttacks(tables, king_square, occupied);
+    check_squares[ROOK] = chess::RookAttacks(tables, king_square, occupied);
+    check_squares[QUEEN] = check_squares[BISHOP] | check_squares[ROOK];
+
+    // Same search as for pins in FilterLegalMoves, with the roles reversed.
+    for (int dir = 0; dir < kNumDirections; dir++) {
+      Bitboard blockers = RayAttacks(tables, dir, king_square, occupied)
+        & occupied;
+      if ((blockers & color_bitboards_[color]).Empty()) {
+        continue;
       }
-      switch (piece.GetPieceType()) {
-      case PAWN:
-        checks = PawnAttacks(move.To(), piece.GetColor(), king_loc);
-        break;
-      case KNIGHT:
-        checks = KnightAttacks(move.To(), king_loc);
-        break;
-      case BISHOP:
-        checks = BishopAttacks(move.To(), king_loc);
-        break;
-      case ROOK:
-        checks = RookAttacks(move.To(), king_loc);
-        break;
-      case QUEEN:
-        checks = QueenAttacks(move.To(), king_loc);
-        break;
-      default:
-        break;
+      int blocker = blockers.Lsb();
+      Bitboard occupied_after = occupied ^ Bitboard::FromSquare(blocker);
+      Bitboard ray = RayAttacks(tables, dir, king_square, occupied_after);
+      Bitboard sliders = piece_type_bitboards_[QUEEN]
+        | piece_type_bitboards_[IsDiagonalDirection(dir) ? BISHOP : ROOK];
+      if ((ray & occupied_after & team_pieces & sliders).Any()) {
+        check_info.blockers[i].Set(blocker);
       }
-      if (checks) {
-        break;
+    }
+  }
+  return check_info;
+}
+
+bool Board::DeliversCheck(const Move& move, const CheckInfo& check_info) {
+  // Castling and en-passant move or remove a second piece, so they are
+  // rare enough to play out. As below, only attackers that the move adds
+  // count, not a check the partner already gives.
+  if (move.GetRookMove().Present() || move.GetEnpassantLocation().Present()) {
+    Team team = turn_.GetTeam();
+    Bitboard attackers_before[2];
+    for (int i = 0; i < 2; i++) {
+      int king_square = check_info.king_squares[i];
+      if (king_square != kNumSquares) {
+        attackers_before[i] = GetAttackersTo(king_square, team, GetOccupied());
+      }
+    }
+    MakeMove(move);
+    bool checks = false;
+    for (int i = 0; i < 2; i++) {
+      int king_square = check_info.king_squares[i];
+      if (king_square != kNumSquares
+          && (GetAttackersTo(king_square, team, GetOccupied())
+              & ~attackers_before[i]).Any()) {
+        checks = true;
       }
     }
+    UndoMove();
+    return checks;
   }
 
-  return checks;
+  const auto& tables = GetBitboardTables();
+  int from = move.From().GetSquare();
+  int to = move.To().GetSquare();
+  PieceType piece_type = move.GetPromotionPieceType() != NO_PIECE
+    ? move.GetPromotionPieceType() : GetPiece(move.From()).GetPieceType();
+
+  for (int i = 0; i < 2; i++) {
+    int king_square = check_info.king_squares[i];
+    if (king_square == kNumSquares) {
+      continue;
+    }
+    if (to == king_square
+        || check_info.check_squares[i][piece_type].Test(to)) {
+      return true;
+    }
+    int dir = tables.direction_to[king_square][from];
+    bool stays_on_line = dir >= 0 && dir == tables.direction_to[king_square][to];
+    if (check_info.blockers[i].Test(from) && !stays_on_line) {
+      return true;
+    }
+    // A slider that moves away from the king along an open line still sees
+    // it through the square it left.
+    if (stays_on_line && check_info.check_squares[i][QUEEN].Test(from)
+        && (piece_type == QUEEN
+            || piece_type == (IsDiagonalDirection(dir) ? BISHOP : ROOK))) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void Board::MakeNullMove() {
@@ -1614,12 +2112,16 @@ bool Move::DeliversCheck(Board& board) {
   return delivers_check_;
 }
 
+bool Move::DeliversCheck(Board& board, const CheckInfo& check_info) {
+  if (delivers_check_ < 0) {
+    delivers_check_ = board.DeliversCheck(*this, check_info);
+  }
+  return delivers_check_;
+}
+
 int Move::SEE(Board& board,
                const int* piece_evaluations) {
-  if (see_ == kSeeNotSet) {
-    see_ = StaticExchangeEvaluationCapture(piece_evaluations, board, *this);
-  }
-  return see_;
+  return StaticExchangeEvaluationCapture(piece_evaluations, board, *this);
 }
 
 int Move::ApproxSEE(Board& board, const int* piece_evaluations) {
@@ -1632,86 +2134,157 @@ int Move::ApproxSEE(Board& board, const int* piece_evaluations) {
 
 namespace {
 
-int StaticExchangeEvaluationFromLists(
-    int square_piece_eval,
-    const std::vector<int>& sorted_piece_values,
-    size_t index,
-    const std::vector<int>& other_team_sorted_piece_values,
-    size_t other_index) {
-  if (index >= sorted_piece_values.size()) {
-    return 0;
-  }
-  int value_capture = square_piece_eval - StaticExchangeEvaluationFromLists(
-      sorted_piece_values[index],
-      other_team_sorted_piece_values,
-      other_index,
-      sorted_piece_values,
-      index + 1);
-  return std::max(0, value_capture);
-}
-
-int StaticExchangeEvaluationFromLocation(
-    const int piece_evaluations[6],
-    const Board& board, const BoardLocation& loc) {
-  constexpr size_t kLimit = 5;
-  PlacedPiece attackers_this_side[kLimit];
-  PlacedPiece attackers_that_side[kLimit];
-
-  size_t num_attackers_this_side = board.GetAttackers2(
-      attackers_this_side, kLimit, board.GetTurn().GetTeam(), loc);
-  size_t num_attackers_that_side = board.GetAttackers2(
-      attackers_that_side, kLimit, OtherTeam(board.GetTurn().GetTeam()), loc);
-
-  std::vector<int> piece_values_this_side;
-  piece_values_this_side.reserve(num_attackers_this_side);
-  std::vector<int> piece_values_that_side;
-  piece_values_that_side.reserve(num_attackers_that_side);
-
-  for (size_t i = 0; i < num_attackers_this_side; ++i) {
-    const auto& placed_piece = attackers_this_side[i];
-    int piece_eval = piece_evaluations[placed_piece.GetPiece().GetPieceType()];
-    piece_values_this_side.push_back(piece_eval);
+// Pieces of both teams bearing on the target square of a capture, updated as
+// the exchange removes them from the board.
+struct Exchange {
+  int to;
+  Bitboard occupied;
+  Bitboard attackers;
+  // Team making the next capture.
+  Team side;
+};
+
+Exchange StartExchange(const Board& board, const Move& move) {
+  Exchange exchange;
+  exchange.to = move.To().GetSquare();
+  exchange.occupied = board.GetOccupied();
+  exchange.occupied.Clear(move.From().GetSquare());
+  if (move.GetEnpassantLocation().Present()) {
+    exchange.occupied.Clear(move.GetEnpassantLocation().GetSquare());
+  }
+  exchange.attackers = board.GetAttackersTo(
+      exchange.to, NO_TEAM, exchange.occupied);
+  exchange.side = OtherTeam(board.GetTurn().GetTeam());
+  return exchange;
+}
+
+// Takes the cheapest attacker of `exchange.side` off the board, reveals any
+// slider behind it and returns its type, or NO_PIECE if the side has none.
+PieceType PopLeastValuableAttacker(
+    const int piece_evaluations[6], const Board& board, Exchange& exchange) {
+  Bitboard side_attackers = exchange.attackers
+    & board.GetTeamBitboard(exchange.side);
+  if (side_attackers.Empty()) {
+    return NO_PIECE;
+  }
+  PieceType piece_type = NO_PIECE;
+  int square = kNumSquares;
+  for (int pt = PAWN; pt <= KING; pt++) {
+    Bitboard pieces = side_attackers
+      & board.GetPieceTypeBitboard(static_cast<PieceType>(pt));
+    if (pieces.Any() && (piece_type == NO_PIECE
+          || piece_evaluations[pt] < piece_evaluations[piece_type])) {
+      piece_type = static_cast<PieceType>(pt);
+      square = pieces.Lsb();
+    }
   }
 
-  for (size_t i = 0; i < num_attackers_that_side; ++i) {
-    const auto& placed_piece = attackers_that_side[i];
-    int piece_eval = piece_evaluations[placed_piece.GetPiece().GetPieceType()];
-    piece_values_that_side.push_back(piece_eval);
+  exchange.occupied.Clear(square);
+  exchange.attackers.Clear(square);
+  const auto& tables = GetBitboardTables();
+  int dir = tables.direction_to[exchange.to][square];
+  if (dir >= 0) {
+    Bitboard sliders = board.GetPieceTypeBitboard(QUEEN)
+      | board.GetPieceTypeBitboard(IsDiagonalDirection(dir) ? BISHOP : ROOK);
+    exchange.attackers |= RayAttacks(tables, dir, exchange.to,
+                                     exchange.occupied)
+      & exchange.occupied & sliders;
   }
+  return piece_type;
+}
 
-  std::sort(piece_values_this_side.begin(), piece_values_this_side.end());
-  std::sort(piece_values_that_side.begin(), piece_values_that_side.end());
-
-  const auto attacking = board.GetPiece(loc);
-  assert(attacking.Present());
-  int attacked_piece_eval = piece_evaluations[attacking.GetPieceType()];
+// A king may not capture onto a square the other team still attacks.
+bool KingCaptureIsLegal(const Board& board, const Exchange& exchange) {
+  return (exchange.attackers
+      & board.GetTeamBitboard(OtherTeam(exchange.side))).Empty();
+}
 
-  return StaticExchangeEvaluationFromLists(
-      attacked_piece_eval,
-      piece_values_this_side,
-      0,
-      piece_values_that_side,
-      0);
+int PieceOnTargetValue(const int piece_evaluations[6], const Board& board,
+                       const Move& move) {
+  PieceType piece_type = move.GetPromotionPieceType() != NO_PIECE
+    ? move.GetPromotionPieceType() : board.GetPiece(move.From()).GetPieceType();
+  return piece_evaluations[piece_type];
 }
 
 } // namespace
 
 int StaticExchangeEvaluationCapture(
     const int piece_evaluations[6],
-    Board& board,
+    const Board& board,
     const Move& move) {
-
   const auto captured = move.GetCapturePiece();
   assert(captured.Present());
 
-  int value = piece_evaluations[captured.GetPieceType()];
+  // gain[d] is what the side making capture d wins if the exchange stops
+  // after it.
+  int gain[kMaxExchangeLength];
+  int depth = 0;
+  gain[0] = piece_evaluations[captured.GetPieceType()];
+  int on_target = PieceOnTargetValue(piece_evaluations, board, move);
+
+  Exchange exchange = StartExchange(board, move);
+  while (depth + 1 < kMaxExchangeLength) {
+    Exchange next = exchange;
+    PieceType piece_type = PopLeastValuableAttacker(
+        piece_evaluations, board, next);
+    if (piece_type == NO_PIECE
+        || (piece_type == KING && !KingCaptureIsLegal(board, next))) {
+      break;
+    }
+    depth++;
+    gain[depth] = on_target - gain[depth - 1];
+    on_target = piece_evaluations[piece_type];
+    exchange = next;
+    exchange.side = OtherTeam(exchange.side);
+  }
 
-  board.MakeMove(move);
-  value -= StaticExchangeEvaluationFromLocation(piece_evaluations, board, move.To());
-  board.UndoMove();
-  return value;
+  // Either side may decline to recapture.
+  while (depth > 0) {
+    gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+    depth--;
+  }
+  return gain[0];
 }
 
+bool StaticExchangeEvaluationGe(
+    const int piece_evaluations[6],
+    const Board& board,
+    const Move& move,
+    int threshold) {
+  const auto captured = move.GetCapturePiece();
+  assert(captured.Present());
+
+  // `swap` is how much the side to capture next must win back to change
+  // the outcome, which is `result` if the exchange stops here.
+  int swap = piece_evaluations[captured.GetPieceType()] - threshold;
+  if (swap < 0) {
+    return false;
+  }
+  swap = PieceOnTargetValue(piece_evaluations, board, move) - swap;
+  if (swap <= 0) {
+    return true;
+  }
+
+  int result = 1;
+  Exchange exchange = StartExchange(board, move);
+  while (true) {
+    PieceType piece_type = PopLeastValuableAttacker(
+        piece_evaluations, board, exchange);
+    if (piece_type == NO_PIECE) {
+      break;
+    }
+    if (piece_type == KING) {
+      return KingCaptureIsLegal(board, exchange) ? !result : result;
+    }
+    result ^= 1;
+    swap = piece_evaluations[piece_type] - swap;
+    if (swap < result) {
+      break;
+    }
+    exchange.side = OtherTeam(exchange.side);
+  }
+  return result;
+}
 
 }  // namespace chess
 
@@ -6,15 +6,19 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <type_traits>
 #include <ostream>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 #include <iostream>
 
+#include "bitboard.h"
+
 namespace chess {
 
 class Board;
+struct CheckInfo;
 
 constexpr int kNumPieceTypes = 6;
 
@@ -141,9 +145,21 @@ class Piece {
   friend std::ostream& operator<<(
       std::ostream& os, const Piece& piece);
 
+  // Fills the border squares of the padded mailbox. It reports Present() so
+  // that a ray walk stops on it with the same test as on a real piece.
+  static Piece OffBoard() {
+    Piece piece;
+    piece.bits_ = kOffBoardBits;
+    return piece;
+  }
+  bool IsOffBoard() const { return bits_ == kOffBoardBits; }
+
   static Piece kNoPiece;
 
  private:
+  // present, piece type 7
+  static constexpr int8_t kOffBoardBits = (int8_t)0b10011100;
+
   // bit 0: presence
   // bit 1-2: player
   // bit 3-5: piece type
@@ -161,10 +177,18 @@ class BoardLocation {
       ? 196 : 14 * row + col;
   }
 
+  static BoardLocation FromSquare(int square) {
+    BoardLocation location;
+    location.loc_ = square;
+    return location;
+  }
+
   bool Present() const { return loc_ < 196; }
   bool Missing() const { return !Present(); }
   int8_t GetRow() const { return loc_ / 14; }
   int8_t GetCol() const { return loc_ % 14; }
+  // Square index (14 * row + col) used by bitboards.
+  int GetSquare() const { return loc_; }
 
   BoardLocation Relative(int8_t delta_row, int8_t delta_col) const {
     return BoardLocation(GetRow() + delta_row, GetCol() + delta_col);
@@ -273,14 +297,10 @@ class Move {
 
   // Standard move
   Move(BoardLocation from, BoardLocation to,
-       Piece standard_capture = Piece::kNoPiece,
-       CastlingRights initial_castling_rights = CastlingRights::kMissingRights,
-       CastlingRights castling_rights = CastlingRights::kMissingRights)
+       Piece standard_capture = Piece::kNoPiece)
     : from_(std::move(from)),
       to_(std::move(to)),
-      standard_capture_(standard_capture),
-      initial_castling_rights_(std::move(initial_castling_rights)),
-      castling_rights_(std::move(castling_rights))
+      standard_capture_(standard_capture)
   { }
 
   // Pawn move
@@ -299,14 +319,10 @@ class Move {
 
   // Castling
   Move(BoardLocation from, BoardLocation to,
-       SimpleMove rook_move,
-       CastlingRights initial_castling_rights,
-       CastlingRights castling_rights)
+       SimpleMove rook_move)
     : from_(std::move(from)),
       to_(std::move(to)),
-      rook_move_(rook_move),
-      initial_castling_rights_(std::move(initial_castling_rights)),
-      castling_rights_(std::move(castling_rights))
+      rook_move_(rook_move)
   { }
 
   const BoardLocation& From() const { return from_; }
@@ -328,12 +344,6 @@ class Move {
     return en_passant_capture_;
   }
   SimpleMove GetRookMove() const { return rook_move_; }
-  CastlingRights GetInitialCastlingRights() const {
-    return initial_castling_rights_;
-  }
-  CastlingRights GetCastlingRights() const {
-    return castling_rights_;
-  }
 
   bool IsCapture() const {
     return standard_capture_.Present() || en_passant_capture_.Present();
@@ -349,9 +359,7 @@ class Move {
         && promotion_piece_type_ == other.promotion_piece_type_
         && en_passant_location_ == other.en_passant_location_
         && en_passant_capture_ == other.en_passant_capture_
-        && rook_move_ == other.rook_move_
-        && initial_castling_rights_ == other.initial_castling_rights_
-        && castling_rights_ == other.castling_rights_;
+        && rook_move_ == other.rook_move_;
   }
   bool operator!=(const Move& other) const {
     return !(*this == other);
@@ -360,8 +368,10 @@ class Move {
   friend std::ostream& operator<<(
       std::ostream& os, const Move& move);
   std::string PrettyStr() const;
-  // NOTE: This does not find discovered checks.
+  // Computes a CheckInfo for the board; prefer the overload below when
+  // checking several moves of the same position.
   bool DeliversCheck(Board& board);
+  bool DeliversCheck(Board& board, const CheckInfo& check_info);
   int SEE(Board& board, const int* piece_evaluations);
   int ApproxSEE(Board& board, const int* piece_evaluations);
 
@@ -382,22 +392,68 @@ class Move {
   // For castling moves
   SimpleMove rook_move_; // 2
 
-  // Castling rights before the move
-  CastlingRights initial_castling_rights_; // 1
-
-  // Castling rights after the move
-  CastlingRights castling_rights_; // 1
-
   // Cached check
   // -1 means missing, 0/1 store check values
   int8_t delivers_check_ = -1; // 1
+};
 
-  static constexpr int kSeeNotSet = -9999999;
+// Moves fill the move buffers, killers and PV lines. Castling rights before
+// a move live on the board's undo stack, and MakeMove works out the rights
+// after it from the moving piece.
+static_assert(sizeof(Move) == 9);
+
+// 32-bit encoding of a move for tables that outlive the position it was
+// made in (the transposition table and the counter-move table). It keeps
+// only the squares and the promotion piece type, which identify a move
+// among the moves of a position; Board::UnpackMove recovers the captures,
+// en-passant and castling details from the board.
+class PackedMove {
+ public:
+  PackedMove() = default;
+  explicit PackedMove(const Move& move)
+    : bits_(move.Present()
+        ? kPresentBit
+          | uint32_t(move.From().GetSquare())
+          | (uint32_t(move.To().GetSquare()) << 8)
+          | (uint32_t(move.GetPromotionPieceType()) << 16)
+        : 0) { }
+
+  bool Present() const { return bits_ != 0; }
+  int From() const { return bits_ & 0xFF; }
+  int To() const { return (bits_ >> 8) & 0xFF; }
+  PieceType GetPromotionPieceType() const {
+    return static_cast<PieceType>((bits_ >> 16) & 0x7);
+  }
 
-  // Static exchange value of the move
-  int see_ = kSeeNotSet;
+  bool operator==(const PackedMove& other) const {
+    return bits_ == other.bits_;
+  }
+  bool operator!=(const PackedMove& other) const {
+    return bits_ != other.bits_;
+  }
+  bool operator==(const Move& other) const {
+    return *this == PackedMove(other);
+  }
+  bool operator!=(const Move& other) const { return !(*this == other); }
+
+  // The move in kCompactBits bits, for storage. Square 0 is a cut-off
+  // corner, so a present move is never 0.
+  static constexpr int kCompactBits = 19;
+  uint32_t Compact() const { return bits_ & ~kPresentBit; }
+  static PackedMove FromCompact(uint32_t compact) {
+    PackedMove packed;
+    packed.bits_ = compact != 0 ? compact | kPresentBit : 0;
+    return packed;
+  }
+
+ private:
+  static constexpr uint32_t kPresentBit = uint32_t(1) << 31;
+
+  uint32_t bits_ = 0;
 };
 
+static_assert(sizeof(PackedMove) == 4);
+
 enum GameResult {
   IN_PROGRESS = 0,
   WIN_RY = 1,
@@ -425,6 +481,29 @@ class PlacedPiece {
   Piece piece_;
 };
 
+// Fixed-capacity list of one color's pieces, stored inline in the Board.
+// Removal moves the last entry into the freed slot, so the order of the
+// list is not preserved.
+class PieceList {
+ public:
+  static constexpr size_t kCapacity = 32;
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const PlacedPiece* begin() const { return pieces_; }
+  const PlacedPiece* end() const { return pieces_ + size_; }
+  const PlacedPiece& operator[](size_t i) const { return pieces_[i]; }
+
+ private:
+  friend class Board;
+
+  PlacedPiece* begin() { return pieces_; }
+  PlacedPiece* end() { return pieces_ + size_; }
+
+  PlacedPiece pieces_[kCapacity];
+  uint8_t size_ = 0;
+};
+
 struct EnpassantInitialization {
   // Indexed by PlayerColor
   std::optional<Move> enp_moves[4] = {std::nullopt, std::nullopt, std::nullopt, std::nullopt};
@@ -446,7 +525,135 @@ struct MoveBuffer {
 };
 
 
-class Board {
+// The 14x14 board surrounded by a 2-square border of off-board sentinels,
+// wide enough that knight jumps from any square stay inside the array.
+constexpr int kPaddedBorder = 2;
+constexpr int kPaddedWidth = 14 + 2 * kPaddedBorder;
+constexpr int kPaddedSquares = kPaddedWidth * kPaddedWidth;
+
+constexpr int PaddedIndex(int row, int col) {
+  return (row + kPaddedBorder) * kPaddedWidth + col + kPaddedBorder;
+}
+constexpr int PaddedOffset(int delta_row, int delta_col) {
+  return delta_row * kPaddedWidth + delta_col;
+}
+
+// Board representation used to generate moves and find attackers. Both
+// produce the same moves in the same order; the switch exists so that they
+// can be benchmarked against each other.
+enum MoveGenLayout : int8_t {
+  LAYOUT_BITBOARD = 0,
+  LAYOUT_PADDED_MAILBOX = 1,
+};
+
+// Subset of moves produced by the move generators. Captures include
+// en-passant and capture-promotions; castling and non-capturing promotions
+// are quiet.
+enum MoveGenType : int8_t {
+  GEN_ALL = 0,
+  GEN_CAPTURES = 1,
+  GEN_QUIETS = 2,
+};
+
+// Zobrist keys shared by every Board. They are generated at compile time
+// from a fixed seed, so hash keys are the same across boards and runs.
+struct ZobristKeys {
+  int64_t piece[4][6][14][14];
+  int64_t turn[4];
+};
+
+extern const ZobristKeys kZobristKeys;
+
+// Per-ply record pushed by MakeMove. UndoMove restores these fields
+// directly rather than recomputing them.
+struct UndoState {
+  Move move;
+  // Piece that was on the target square, if any.
+  Piece captured;
+  // The mover's castling rights before the move.
+  CastlingRights castling_rights;
+  int64_t hash_key = 0;
+};
+
+// Plies of undo state kept inside the board. Longer games spill the rest
+// onto the heap.
+constexpr int kInlineUndoPlies = 2048;
+
+// What the side to move needs to know to tell whether a move gives check,
+// computed once per position (see Board::GetCheckInfo). Indexed by the two
+// enemy kings, the next player's first.
+struct CheckInfo {
+  // kNumSquares if the king has been captured.
+  int king_squares[2] = {kNumSquares, kNumSquares};
+  // Squares from which a piece of each type would attack the king. Empty
+  // for kings.
+  Bitboard check_squares[2][6];
+  // Pieces of the side to move that stand alone between the king and a
+  // slider of their team, so that moving them off the line discovers check.
+  Bitboard blockers[2];
+};
+
+// Summary of one player's pseudo-legal moves (see
+// Board::CountPseudoLegalMoves).
+struct MoveCounts {
+  int num_moves = 0;
+  // Captures for which Move::ApproxSEE is at least the threat threshold.
+  int num_threats = 0;
+  // Moves of each piece, in the order of the player's piece list, that land
+  // on the given squares. Zero for pawns and castling.
+  uint8_t piece_moves[PieceList::kCapacity] = {};
+};
+
+// Pieces of one team that the other team threatens, from the attack sets of
+// both teams (see Board::GetThreats). Kings are left out.
+struct Threats {
+  // Attacked by an enemy piece worth at least the margin less.
+  Bitboard by_lesser;
+  // Attacked by an enemy piece and defended by none of their own team.
+  Bitboard hanging;
+};
+
+// Positional value of a piece on a square, indexed by color, piece type, row
+// and col.
+using PieceSquareTable = int[4][6][14][14];
+
+// The part of a Board that changes as moves are made and unmade, apart from
+// the undo stack. It holds no pointers to owned memory, so copying a board
+// copies it with a memcpy; the fields read on every node come first.
+struct BoardState {
+  Player turn_;
+  int num_plies_ = 0;
+  int64_t hash_key_ = 0;
+  int64_t pawn_key_ = 0;
+  int piece_evaluation_ = 0;
+  int piece_square_evaluations_[4] = {0, 0, 0, 0};
+  int player_piece_evaluations_[4] = {0, 0, 0, 0}; // one per player
+  const PieceSquareTable* piece_square_table_ = nullptr;
+  BoardLocation king_locations_[4];
+  CastlingRights castling_rights_[4];
+  MoveGenLayout layout_ = LAYOUT_BITBOARD;
+  bool track_attacks_ = false;
+
+  // Indexed by PlayerColor, Team and PieceType. The NO_TEAM entry holds
+  // every piece on the board.
+  Bitboard color_bitboards_[4];
+  Bitboard team_bitboards_[3];
+  Bitboard piece_type_bitboards_[6];
+
+  Piece location_to_piece_[14][14];
+  // Same contents as location_to_piece_, indexed by PaddedIndex.
+  Piece padded_board_[kPaddedSquares];
+  PieceList piece_list_[4];
+  // Slot in piece_list_ of the piece on each square.
+  uint8_t piece_slot_[kNumSquares];
+  EnpassantInitialization enp_;
+  // Indexed by Team and square.
+  uint8_t attack_counts_[2][kNumSquares];
+};
+
+static_assert(std::is_trivially_copyable_v<BoardState>);
+
+class Board : private BoardState {
  // Conventions:
  // - Red is on the bottom of the board, blue on the left, yellow on top,
  //   green on the right
@@ -461,9 +668,37 @@ class Board {
         castling_rights = std::nullopt,
       std::optional<EnpassantInitialization> enp = std::nullopt);
 
-  Board(const Board&) = default;
+  // Copy the position and only the used part of the undo stack.
+  Board(const Board& other);
+  Board& operator=(const Board& other);
 
-  size_t GetPseudoLegalMoves2(Move* buffer, size_t limit);
+  // Replaces the position in place, without allocating. `pieces` is indexed
+  // by row and column, with Piece() on empty squares. The move history is
+  // cleared; the move generation layout, attack maps and piece-square table
+  // stay as they were.
+  void SetPosition(
+      Player turn,
+      const Piece (&pieces)[14][14],
+      const CastlingRights (&castling_rights)[4],
+      const EnpassantInitialization& enp);
+
+  size_t GetPseudoLegalMoves2(Move* buffer, size_t limit,
+                              MoveGenType type = GEN_ALL);
+  // Counts the moves that GetPseudoLegalMoves2 would generate if it were
+  // `color`'s turn, from attack sets rather than by generating them.
+  MoveCounts CountPseudoLegalMoves(
+      PlayerColor color, const int piece_evaluations[6],
+      int threat_threshold, const Bitboard& piece_move_squares) const;
+  // Moves that do not leave the mover's king attacked, plus any move that
+  // captures a king. Pins and checkers are computed once; only castling and
+  // en-passant moves are verified by making them.
+  size_t GetLegalMoves(Move* buffer, size_t limit);
+  // The capturing and non-capturing halves of GetLegalMoves.
+  size_t GetCaptureMoves(Move* buffer, size_t limit);
+  size_t GetQuietMoves(Move* buffer, size_t limit);
+  // The move of the side to move that `packed` encodes, if the mover has a
+  // piece on its from square that can make it.
+  std::optional<Move> UnpackMove(PackedMove packed) const;
 
   bool IsKingInCheck(const Player& player) const;
   bool IsKingInCheck(Team team) const;
@@ -474,6 +709,18 @@ class Board {
   Team TeamToPlay() const;
   int PieceEvaluation() const;
   int PieceEvaluation(PlayerColor color) const;
+  // Sums of `table` over each color's pieces, kept up to date by SetPiece
+  // and RemovePiece like the piece evaluation. The table is not copied and
+  // must outlive the board; nullptr stops the tracking.
+  void SetPieceSquareTable(const PieceSquareTable* table);
+  // RY minus BG, and per color.
+  int PieceSquareEvaluation() const {
+    return piece_square_evaluations_[RED] + piece_square_evaluations_[YELLOW]
+      - piece_square_evaluations_[BLUE] - piece_square_evaluations_[GREEN];
+  }
+  int PieceSquareEvaluation(PlayerColor color) const {
+    return piece_square_evaluations_[color];
+  }
   int MobilityEvaluation();
   int MobilityEvaluation(const Player& player);
   const Player& GetTurn() const { return turn_; }
@@ -489,8 +736,56 @@ class Board {
       PlacedPiece* buffer, size_t limit,
       Team team, const BoardLocation& location) const;
 
+  MoveGenLayout GetMoveGenLayout() const { return layout_; }
+  void SetMoveGenLayout(MoveGenLayout layout) { layout_ = layout; }
+
+  // Optional per-team attack counts for every square, kept up to date by
+  // SetPiece and RemovePiece. While enabled, IsAttackedByTeam and
+  // IsKingInCheck are table lookups, at the cost of slower make/unmake.
+  void EnableAttackMaps(bool enable);
+  bool AttackMapsEnabled() const { return track_attacks_; }
+  // Number of pieces of `team` (RED_YELLOW or BLUE_GREEN) attacking the
+  // square. Requires attack maps to be enabled.
+  int GetAttackCount(Team team, const BoardLocation& location) const {
+    return attack_counts_[team][location.GetSquare()];
+  }
+
+  // Occupancy bitboards, kept in sync with the mailbox by SetPiece and
+  // RemovePiece.
+  const Bitboard& GetOccupied() const { return team_bitboards_[NO_TEAM]; }
+  const Bitboard& GetColorBitboard(PlayerColor color) const {
+    return color_bitboards_[color];
+  }
+  const Bitboard& GetTeamBitboard(Team team) const {
+    return team_bitboards_[team];
+  }
+  const Bitboard& GetPieceTypeBitboard(PieceType piece_type) const {
+    return piece_type_bitboards_[piece_type];
+  }
+  Bitboard GetPieces(PlayerColor color, PieceType piece_type) const {
+    return color_bitboards_[color] & piece_type_bitboards_[piece_type];
+  }
+  // Pieces of `team` (or of both teams if NO_TEAM) that attack `square`,
+  // given the occupancy `occupied`.
+  Bitboard GetAttackersTo(
+      int square, Team team, const Bitboard& occupied) const;
+  // Squares attacked by `piece` standing on `square`.
+  Bitboard GetAttacks(
+      const Piece& piece, int square, const Bitboard& occupied) const;
+  // Pieces of `team` threatened by the other team. Players whose king has
+  // been captured can no longer move, so their pieces neither attack nor
+  // defend.
+  Threats GetThreats(
+      Team team, const int piece_evaluations[6], int margin) const;
+
   BoardLocation GetKingLocation(PlayerColor color) const;
-  bool DeliversCheck(const Move& move);
+  CheckInfo GetCheckInfo() const;
+  // Whether the move attacks an enemy king, directly or by discovery, or
+  // captures one.
+  bool DeliversCheck(const Move& move, const CheckInfo& check_info);
+  bool DeliversCheck(const Move& move) {
+    return DeliversCheck(move, GetCheckInfo());
+  }
 
   const Piece& GetPiece(
       int row, int col) const {
@@ -511,56 +806,92 @@ class Board {
       Team attacking_team) const;
 
   int64_t HashKey() const { return hash_key_; }
+  // Zobrist key of the pawns alone.
+  int64_t PawnKey() const { return pawn_key_; }
 
   static std::shared_ptr<Board> CreateStandardSetup();
 //  bool operator==(const Board& other) const;
 //  bool operator!=(const Board& other) const;
-  const CastlingRights& GetCastlingRights(const Player& player);
+  const CastlingRights& GetCastlingRights(const Player& player) const;
 
   void MakeMove(const Move& move);
   void UndoMove();
   bool LastMoveWasCapture() const {
-    return !moves_.empty() && moves_.back().GetStandardCapture().Present();
+    return num_plies_ > 0 && GetUndoState(num_plies_ - 1).captured.Present();
   }
   const Move& GetLastMove() const {
-    return moves_.back();
+    return GetUndoState(num_plies_ - 1).move;
   }
-  int NumMoves() const { return moves_.size(); }
-  const std::vector<Move>& Moves() { return moves_; }
+  int NumMoves() const { return num_plies_; }
+  // The move made at the given ply, counted from the start of the game.
+  const Move& GetMove(int ply) const { return GetUndoState(ply).move; }
+  std::vector<Move> Moves() const;
 
 
   void GetPawnMoves2(
       MoveBuffer& moves,
       const BoardLocation& from,
-      const Piece& piece) const;
+      const Piece& piece,
+      MoveGenType type) const;
   void GetKnightMoves2(
       MoveBuffer& moves,
       const BoardLocation& from,
-      const Piece& piece) const;
+      const Piece& piece,
+      MoveGenType type) const;
   void GetBishopMoves2(
       MoveBuffer& moves,
       const BoardLocation& from,
-      const Piece& piece) const;
+      const Piece& piece,
+      MoveGenType type) const;
   void GetRookMoves2(
       MoveBuffer& moves,
       const BoardLocation& from,
-      const Piece& piece) const;
+      const Piece& piece,
+      MoveGenType type) const;
   void GetQueenMoves2(
       MoveBuffer& moves,
       const BoardLocation& from,
-      const Piece& piece) const;
+      const Piece& piece,
+      MoveGenType type) const;
   void GetKingMoves2(
+      MoveBuffer& moves,
+      const BoardLocation& from,
+      const Piece& piece,
+      MoveGenType type) const;
+  void GetCastlingMoves2(
       MoveBuffer& moves,
       const BoardLocation& from,
       const Piece& piece) const;
+  // Where `piece`, a pawn blocked by the enemy pawn `other_piece` on `to`,
+  // lands if it captures that pawn en passant, or kNoLocation if it cannot.
+  BoardLocation GetEnpassantTarget(
+      const Piece& piece,
+      const BoardLocation& to,
+      const Piece& other_piece) const;
   void AddMovesFromIncrMovement2(
       MoveBuffer& moves,
       const Piece& piece,
       const BoardLocation& from,
       int incr_row,
       int incr_col,
-      CastlingRights initial_castling_rights = CastlingRights::kMissingRights,
-      CastlingRights castling_rights = CastlingRights::kMissingRights) const;
+      MoveGenType type) const;
+
+  // Padded mailbox counterparts of AddMovesFromIncrMovement2 and
+  // GetAttackers2.
+  void AddMovesFromPaddedRay(
+      MoveBuffer& moves,
+      const Piece& piece,
+      const BoardLocation& from,
+      int offset,
+      MoveGenType type) const;
+  size_t GetAttackersPadded(
+      PlacedPiece* buffer, size_t limit,
+      Team team, const BoardLocation& location) const;
+  // Squares that a piece of `team` may move to for the given type.
+  Bitboard GetMoveTargets(Team team, MoveGenType type) const;
+  // Drops the moves in `buffer` that leave the mover's king attacked and
+  // returns how many remain.
+  size_t FilterLegalMoves(Move* buffer, size_t num_moves);
 
 
   friend std::ostream& operator<<(
@@ -587,8 +918,11 @@ class Board {
   bool IsLegalLocation(const BoardLocation& location) const {
     return IsLegalLocation(location.GetRow(), location.GetCol());
   }
-  const EnpassantInitialization& GetEnpassantInitialization() { return enp_; }
-  const std::vector<std::vector<PlacedPiece>>& GetPieceList() { return piece_list_; };
+  const EnpassantInitialization& GetEnpassantInitialization() const {
+    return enp_;
+  }
+  // Indexed by PlayerColor.
+  const PieceList* GetPieceList() const { return piece_list_; };
 
  private:
   void AddMovesFromIncrMovement(
@@ -596,9 +930,7 @@ class Board {
       const Piece& piece,
       const BoardLocation& from,
       int incr_row,
-      int incr_col,
-      CastlingRights initial_castling_rights = CastlingRights::kMissingRights,
-      CastlingRights castling_rights = CastlingRights::kMissingRights) const;
+      int incr_col) const;
   int GetMaxRow() const { return 13; }
   int GetMaxCol() const { return 13; }
   std::optional<CastlingType> GetRookLocationType(
@@ -628,34 +960,48 @@ class Board {
 
   void InitializeHash();
   void UpdatePieceHash(const Piece& piece, const BoardLocation& loc) {
-    hash_key_ ^= piece_hashes_[piece.GetColor()][piece.GetPieceType()]
+    int64_t key = kZobristKeys.piece[piece.GetColor()][piece.GetPieceType()]
       [loc.GetRow()][loc.GetCol()];
+    hash_key_ ^= key;
+    if (piece.GetPieceType() == PAWN) {
+      pawn_key_ ^= key;
+    }
   }
   void UpdateTurnHash(int turn) {
-    hash_key_ ^= turn_hashes_[turn];
+    hash_key_ ^= kZobristKeys.turn[turn];
+  }
+  void AddToPieceList(const BoardLocation& location, const Piece& piece);
+  void RemoveFromPieceList(const BoardLocation& location, PlayerColor color);
+  void RecomputeAttackMaps();
+  void AddAttackCounts(Team team, Bitboard squares, int delta);
+  void UpdateSliderRaysThrough(int square, int delta);
+
+  // Toggles the piece on `loc` in every bitboard it belongs to.
+  void UpdatePieceBitboards(const Piece& piece, const BoardLocation& loc) {
+    int square = loc.GetSquare();
+    color_bitboards_[piece.GetColor()].Toggle(square);
+    team_bitboards_[piece.GetTeam()].Toggle(square);
+    team_bitboards_[NO_TEAM].Toggle(square);
+    piece_type_bitboards_[piece.GetPieceType()].Toggle(square);
   }
 
-  Player turn_;
-
-  Piece location_to_piece_[14][14];
-  std::vector<std::vector<PlacedPiece>> piece_list_;
-
-  BoardLocation locations_[14][14];
-
-  CastlingRights castling_rights_[4];
-  EnpassantInitialization enp_;
-  std::vector<Move> moves_; // list of moves from beginning of game
-  std::vector<Move> move_buffer_;
-  int piece_evaluation_ = 0;
-  int player_piece_evaluations_[4] = {0, 0, 0, 0}; // one per player
-
-  int64_t hash_key_ = 0;
-  int64_t piece_hashes_[4][6][14][14];
-  int64_t turn_hashes_[4];
-  BoardLocation king_locations_[4];
+  UndoState& GetUndoState(int ply) {
+    return ply < kInlineUndoPlies
+      ? undo_stack_[ply] : undo_overflow_[ply - kInlineUndoPlies];
+  }
+  const UndoState& GetUndoState(int ply) const {
+    return ply < kInlineUndoPlies
+      ? undo_stack_[ply] : undo_overflow_[ply - kInlineUndoPlies];
+  }
 
-  size_t move_buffer_size_ = 300;
-  Move move_buffer_2_[300];
+  // Moves from the beginning of the game and their undo state. Entries past
+  // num_plies_ are left uninitialized so that constructing and copying a
+  // board only touches the part in use.
+  union {
+    UndoState undo_stack_[kInlineUndoPlies];
+  };
+  // Undo state for plies past kInlineUndoPlies.
+  std::vector<UndoState> undo_overflow_;
 };
 
 // Helper functions
@@ -666,12 +1012,27 @@ Player GetNextPlayer(const Player& player);
 Player GetPreviousPlayer(const Player& player);
 Player GetPartner(const Player& player);
 
-// Returns the static exchange evaluation of a capture.
+// Longest exchange on one square that the static exchange evaluation
+// follows.
+constexpr int kMaxExchangeLength = 64;
+
+// Returns the static exchange evaluation of a capture: the material the
+// mover wins if both teams keep recapturing on the target square with their
+// cheapest attacker for as long as it pays. Sliders behind other attackers
+// join in once the way is clear. The board is not modified.
 int StaticExchangeEvaluationCapture(
     const int piece_evaluations[6],
-    Board& board,
+    const Board& board,
     const Move& move);
 
+// Whether StaticExchangeEvaluationCapture(...) >= threshold. Stops as soon as
+// the answer is known.
+bool StaticExchangeEvaluationGe(
+    const int piece_evaluations[6],
+    const Board& board,
+    const Move& move,
+    int threshold);
+
 
 }  // namespace chess
 
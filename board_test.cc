@@ -1,5 +1,5 @@
-
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <gtest/gtest.h>
 #include "gmock/gmock.h"
@@ -10,7 +10,9 @@
 namespace chess {
 
 using Loc = BoardLocation;
+using ::testing::ElementsAre;
 using ::testing::UnorderedElementsAre;
+using ::testing::UnorderedElementsAreArray;
 
 namespace {
 
@@ -29,6 +31,21 @@ std::vector<Move> GetMoves(Board& board, PieceType piece_type) {
   return moves;
 }
 
+// Finds a pseudo-legal move. ParseMove only accepts legal moves.
+std::optional<Move> FindMove(
+    Board& board, const BoardLocation& from, const BoardLocation& to) {
+  Move moves[300];
+  size_t num_moves = board.GetPseudoLegalMoves2(moves, 300);
+  for (size_t i = 0; i < num_moves; i++) {
+    const auto& move = moves[i];
+    if (move.From() == from
+        && move.To() == to) {
+      return move;
+    }
+  }
+  return std::nullopt;
+}
+
 }  // namespace
 
 TEST(BoardLocationTest, Properties) {
@@ -691,8 +708,8 @@ TEST(BoardTest, GetLegalMoves_King) {
         ParseMove(*board, "h1-i1"),
         ParseMove(*board, "h1-j1"),
         // pseudo legal moves into check
-        ParseMove(*board, "h1-g1"),
-        ParseMove(*board, "h1-g2")));
+        FindMove(*board, Loc(13, 7), Loc(13, 6)),
+        FindMove(*board, Loc(13, 7), Loc(12, 6))));
 
   // castling not allowed while in check
 
@@ -703,9 +720,146 @@ TEST(BoardTest, GetLegalMoves_King) {
       UnorderedElementsAre(
         ParseMove(*board, "h1-i1"),
         // pseudo legal moves into check
-        ParseMove(*board, "h1-g1"),
-        ParseMove(*board, "h1-g2")));
+        FindMove(*board, Loc(13, 7), Loc(13, 6)),
+        FindMove(*board, Loc(13, 7), Loc(12, 6))));
+
+}
+
+namespace {
+
+// Legal moves computed the slow way: make each pseudo-legal move and check
+// whether the mover's king is attacked.
+std::vector<Move> FilterLegalMoves(Board& board) {
+  Move moves[300];
+  size_t num_moves = board.GetPseudoLegalMoves2(moves, 300);
+  Player player = board.GetTurn();
+  std::vector<Move> legal;
+  for (size_t i = 0; i < num_moves; i++) {
+    board.MakeMove(moves[i]);
+    if (board.CheckWasLastMoveKingCapture() != IN_PROGRESS
+        || !board.IsKingInCheck(player)) {
+      legal.push_back(moves[i]);
+    }
+    board.UndoMove();
+  }
+  return legal;
+}
+
+std::vector<Move> GetLegalMoves(Board& board) {
+  Move moves[300];
+  size_t num_moves = board.GetLegalMoves(moves, 300);
+  return std::vector<Move>(moves, moves + num_moves);
+}
+
+}  // namespace
 
+TEST(BoardTest, GetLegalMoves) {
+  // castling through check and moving into check are not allowed
+  auto board = ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,2,yK,3,yR,x,x,x/x,x,x,yP,yP,yP,yP,yP,yP,yP,yP,x,x,x/x,x,x,8,x,x,x/bR,bP,10,gP,gR/1,bP,10,gP,1/1,bP,10,gP,1/1,bP,4,bR,5,gP,gK/bK,bP,10,gP,1/1,bP,10,gP,1/1,bP,10,gP,1/bR,bP,10,gP,gR/x,x,x,8,x,x,x/x,x,x,rP,rP,rP,1,rP,rP,rP,rP,x,x,x/x,x,x,rR,3,rK,2,rR,x,x,x");
+  std::vector<Move> king_moves;
+  for (const auto& move : GetLegalMoves(*board)) {
+    if (move.From() == Loc(13, 7)) {
+      king_moves.push_back(move);
+    }
+  }
+  EXPECT_THAT(
+      king_moves,
+      UnorderedElementsAre(
+        ParseMove(*board, "h1-i1"),
+        ParseMove(*board, "h1-j1")));
+  EXPECT_THAT(GetLegalMoves(*board),
+              UnorderedElementsAreArray(FilterLegalMoves(*board)));
+
+  // in check, with pinned pieces
+  board = ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,0,1,1-0,0,0,0-2-x,x,x,yR,yN,1,yK,1,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yP,yP,yP,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,2,bP,8,gP,1/bQ,bP,9,gP,1,gK/bK,bP,bP,1,yQ,7,gP,1/bB,11,gP,gB/bN,1,bP,6,gB,2,gP,gN/3,bR,1,rP,6,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,1,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,1,rB,rQ,rK,1,rN,rR,x,x,x");
+  for (int i = 0; i < 4; i++) {
+    EXPECT_THAT(GetLegalMoves(*board),
+              UnorderedElementsAreArray(FilterLegalMoves(*board)));
+    board->MakeMove(GetLegalMoves(*board)[0]);
+  }
+
+  board = Board::CreateStandardSetup();
+  board->MakeMove(Move(BoardLocation(12, 7), BoardLocation(11, 7))); // h3
+  board->MakeMove(Move(BoardLocation(7, 1), BoardLocation(7, 2))); // c7
+  board->MakeMove(Move(BoardLocation(1, 6), BoardLocation(2, 6))); // g12
+  board->MakeMove(Move(BoardLocation(6, 12), BoardLocation(6, 11))); // l8
+  board->MakeMove(Move(BoardLocation(13, 6), BoardLocation(7, 12),
+                  board->GetPiece(BoardLocation(7, 12)))); // Qxm7
+  // blue to move while green is in check
+  EXPECT_THAT(GetLegalMoves(*board),
+              UnorderedElementsAreArray(FilterLegalMoves(*board)));
+  board->MakeMove(GetLegalMoves(*board)[0]);
+  EXPECT_THAT(GetLegalMoves(*board),
+              UnorderedElementsAreArray(FilterLegalMoves(*board)));
+  board->MakeMove(GetLegalMoves(*board)[0]);
+  EXPECT_THAT(GetLegalMoves(*board),
+              UnorderedElementsAreArray(FilterLegalMoves(*board)));
+}
+
+TEST(BoardTest, GetCaptureAndQuietMoves) {
+  auto board = ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,0,1,1-0,0,0,0-2-x,x,x,yR,yN,1,yK,1,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yP,yP,yP,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,2,bP,8,gP,1/bQ,bP,9,gP,1,gK/bK,bP,bP,1,yQ,7,gP,1/bB,11,gP,gB/bN,1,bP,6,gB,2,gP,gN/3,bR,1,rP,6,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,1,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,1,rB,rQ,rK,1,rN,rR,x,x,x");
+  Move moves[300];
+  for (MoveGenLayout layout : {LAYOUT_BITBOARD, LAYOUT_PADDED_MAILBOX}) {
+    board->SetMoveGenLayout(layout);
+    for (int i = 0; i < 12; i++) {
+      std::vector<Move> split;
+      size_t num_moves = board->GetCaptureMoves(moves, 300);
+      for (size_t j = 0; j < num_moves; j++) {
+        EXPECT_TRUE(moves[j].IsCapture());
+        split.push_back(moves[j]);
+      }
+      num_moves = board->GetQuietMoves(moves, 300);
+      for (size_t j = 0; j < num_moves; j++) {
+        EXPECT_FALSE(moves[j].IsCapture());
+        split.push_back(moves[j]);
+      }
+      EXPECT_THAT(split, UnorderedElementsAreArray(GetLegalMoves(*board)));
+
+      // Prefer captures so that the position keeps changing.
+      num_moves = board->GetCaptureMoves(moves, 300);
+      if (num_moves == 0) {
+        num_moves = board->GetQuietMoves(moves, 300);
+      }
+      ASSERT_GT(num_moves, 0);
+      board->MakeMove(moves[i % num_moves]);
+    }
+  }
+}
+
+TEST(BoardTest, PackedMove) {
+  // both sides can castle
+  auto board = ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,2,yK,3,yR,x,x,x/x,x,x,yP,yP,yP,yP,yP,yP,yP,yP,x,x,x/x,x,x,8,x,x,x/bR,bP,10,gP,gR/1,bP,10,gP,1/1,bP,10,gP,1/1,bP,4,bR,5,gP,gK/bK,bP,10,gP,1/1,bP,10,gP,1/1,bP,10,gP,1/bR,bP,10,gP,gR/x,x,x,8,x,x,x/x,x,x,rP,rP,rP,1,rP,rP,rP,rP,x,x,x/x,x,x,rR,3,rK,2,rR,x,x,x");
+  Move moves[300];
+  for (int i = 0; i < 8; i++) {
+    size_t num_moves = board->GetPseudoLegalMoves2(moves, 300);
+    for (size_t j = 0; j < num_moves; j++) {
+      PackedMove packed(moves[j]);
+      EXPECT_EQ(moves[j].From().GetSquare(), packed.From());
+      EXPECT_EQ(moves[j].To().GetSquare(), packed.To());
+      EXPECT_EQ(moves[j].GetPromotionPieceType(),
+                packed.GetPromotionPieceType());
+      std::optional<Move> unpacked = board->UnpackMove(packed);
+      ASSERT_TRUE(unpacked.has_value());
+      EXPECT_EQ(moves[j], *unpacked);
+    }
+    board->MakeMove(moves[i % num_moves]);
+  }
+
+  EXPECT_FALSE(PackedMove().Present());
+  EXPECT_FALSE(PackedMove(Move()).Present());
+  EXPECT_EQ(std::nullopt, board->UnpackMove(PackedMove()));
+  // no piece on the from square
+  EXPECT_EQ(std::nullopt, board->UnpackMove(PackedMove(
+          Move(BoardLocation(7, 7), BoardLocation(6, 7)))));
+
+  // Moves saved for another position, as a transposition table may return.
+  auto start = Board::CreateStandardSetup();
+  // a piece of another player
+  EXPECT_EQ(std::nullopt, start->UnpackMove(PackedMove(
+          Move(BoardLocation(7, 1), BoardLocation(7, 3)))));
+  // a blocked rook
+  EXPECT_EQ(std::nullopt, start->UnpackMove(PackedMove(
+          Move(BoardLocation(13, 3), BoardLocation(11, 3)))));
 }
 
 //TEST(BoardTest, GetLegalMoves_King) {
@@ -1484,6 +1638,55 @@ TEST(BoardTest, KeyTest) {
   EXPECT_NE(h0, h5);
 }
 
+TEST(BoardTest, ZobristKeys) {
+  std::unordered_set<int64_t> keys(
+      std::begin(kZobristKeys.turn), std::end(kZobristKeys.turn));
+  for (const auto& color_keys : kZobristKeys.piece) {
+    for (const auto& piece_keys : color_keys) {
+      for (const auto& row_keys : piece_keys) {
+        keys.insert(std::begin(row_keys), std::end(row_keys));
+      }
+    }
+  }
+  EXPECT_EQ(4 + 4 * 6 * 14 * 14, (int)keys.size());
+
+  // Keys do not depend on the board instance.
+  EXPECT_EQ(Board::CreateStandardSetup()->HashKey(),
+            Board::CreateStandardSetup()->HashKey());
+}
+
+TEST(BoardTest, PawnKey) {
+  auto board = Board::CreateStandardSetup();
+  int64_t start_key = board->PawnKey();
+  int64_t start_hash = board->HashKey();
+
+  // A knight move leaves the pawn key alone.
+  board->MakeMove(Move(BoardLocation(13, 4), BoardLocation(11, 5)));
+  EXPECT_EQ(start_key, board->PawnKey());
+  EXPECT_NE(start_hash, board->HashKey());
+  board->UndoMove();
+
+  board->MakeMove(Move(BoardLocation(12, 7), BoardLocation(10, 7)));
+  int64_t key = board->PawnKey();
+  EXPECT_NE(start_key, key);
+  board->MakeNullMove();
+  EXPECT_EQ(key, board->PawnKey());
+  board->UndoNullMove();
+  board->UndoMove();
+  EXPECT_EQ(start_key, board->PawnKey());
+
+  // The key only depends on where the pawns stand.
+  int64_t expected = 0;
+  for (int color = 0; color < 4; color++) {
+    Bitboard pawns = board->GetPieces(static_cast<PlayerColor>(color), PAWN);
+    while (pawns.Any()) {
+      const auto loc = BoardLocation::FromSquare(pawns.PopLsb());
+      expected ^= kZobristKeys.piece[color][PAWN][loc.GetRow()][loc.GetCol()];
+    }
+  }
+  EXPECT_EQ(expected, start_key);
+}
+
 TEST(BoardTest, KeyTest_NullMove) {
   auto board = Board::CreateStandardSetup();
   int64_t h0 = board->HashKey();
@@ -1537,28 +1740,120 @@ TEST(BoardTest, IsKingInCheckFalse) {
   EXPECT_FALSE(board->IsKingInCheck(Player(GREEN)));
 }
 
-//TEST(BoardTest, Enpassant) {
-//  auto board = 
-//}
+TEST(BoardTest, BitboardsMatchMailbox) {
+  auto board = Board::CreateStandardSetup();
+  board->MakeMove(Move(BoardLocation(12, 7), BoardLocation(11, 7))); // h3
+  board->MakeMove(Move(BoardLocation(7, 1), BoardLocation(7, 2))); // c7
+  board->MakeMove(Move(BoardLocation(1, 6), BoardLocation(2, 6))); // g12
+  board->MakeMove(Move(BoardLocation(6, 12), BoardLocation(6, 11))); // l8
+  board->MakeMove(Move(BoardLocation(13, 6), BoardLocation(7, 12),
+                  board->GetPiece(BoardLocation(7, 12)))); // Qxm7
+
+  for (int square = 0; square < kNumSquares; square++) {
+    const auto& piece = board->GetPiece(BoardLocation::FromSquare(square));
+    EXPECT_EQ(board->GetOccupied().Test(square), piece.Present());
+    for (int color = 0; color < 4; color++) {
+      EXPECT_EQ(
+          board->GetColorBitboard(static_cast<PlayerColor>(color)).Test(square),
+          piece.Present() && piece.GetColor() == color);
+    }
+  }
+  EXPECT_EQ(board->GetPieces(RED, QUEEN),
+            Bitboard::FromSquare(BoardLocation(7, 12).GetSquare()));
+
+  board->UndoMove();
+  EXPECT_EQ(board->GetPieces(RED, QUEEN),
+            Bitboard::FromSquare(BoardLocation(13, 6).GetSquare()));
+  EXPECT_EQ(board->GetOccupied().Count(), 64);
+}
+
+TEST(BoardTest, GetAttackersTo) {
+  auto board = Board::CreateStandardSetup();
+  // The knight and two pawns defend f3.
+  int square = BoardLocation(11, 5).GetSquare();
+  Bitboard attackers = board->GetAttackersTo(
+      square, RED_YELLOW, board->GetOccupied());
+  EXPECT_EQ(attackers.Count(), 3);
+  EXPECT_TRUE(attackers.Test(BoardLocation(13, 4).GetSquare()));
+  EXPECT_TRUE(attackers.Test(BoardLocation(12, 4).GetSquare()));
+  EXPECT_TRUE(attackers.Test(BoardLocation(12, 6).GetSquare()));
+  EXPECT_TRUE(board->GetAttackersTo(
+      square, BLUE_GREEN, board->GetOccupied()).Empty());
+
+  // Diagonals stop at the cut-off corners instead of re-entering the board.
+  const auto& tables = GetBitboardTables();
+  EXPECT_FALSE(tables.rays[NORTH_EAST][BoardLocation(3, 1).GetSquare()]
+               .Test(BoardLocation(1, 3).GetSquare()));
+}
+
+TEST(BoardTest, GeometryTables) {
+  const auto& tables = GetBitboardTables();
+  int square = BoardLocation(3, 3).GetSquare();
+
+  // The north-west ray from d11 ends at the corner.
+  EXPECT_EQ(tables.ray_length[NORTH_WEST][square], 0);
+  ASSERT_EQ(tables.ray_length[EAST][square], 10);
+  EXPECT_EQ(tables.ray_squares[EAST][square][0],
+            BoardLocation(3, 4).GetSquare());
+  EXPECT_EQ(tables.ray_squares[EAST][square][9],
+            BoardLocation(3, 13).GetSquare());
+  EXPECT_EQ(tables.direction_to[square][BoardLocation(10, 10).GetSquare()],
+            SOUTH_EAST);
+  EXPECT_EQ(tables.direction_to[square][BoardLocation(4, 5).GetSquare()], -1);
+
+  EXPECT_EQ(tables.pawn_push[RED][BoardLocation(12, 4).GetSquare()],
+            BoardLocation(11, 4).GetSquare());
+  EXPECT_EQ(tables.pawn_double_push[RED][BoardLocation(12, 4).GetSquare()],
+            BoardLocation(10, 4).GetSquare());
+  EXPECT_EQ(tables.pawn_double_push[BLUE][BoardLocation(5, 2).GetSquare()],
+            kNumSquares);
+  EXPECT_TRUE(tables.pawn_promotion[GREEN].Test(
+        BoardLocation(7, 3).GetSquare()));
+}
 
 namespace {
 
-std::optional<Move> FindMove(
-    Board& board, const BoardLocation& from, const BoardLocation& to) {
-  Move moves[300];
-  size_t num_moves = board.GetPseudoLegalMoves2(moves, 300);
-  for (size_t i = 0; i < num_moves; i++) {
-    const auto& move = moves[i];
-    if (move.From() == from
-        && move.To() == to) {
-      return move;
+void ExpectAttackMapsMatch(const Board& board) {
+  for (int square = 0; square < kNumSquares; square++) {
+    if (!GetBitboardTables().legal.Test(square)) {
+      continue;
+    }
+    auto location = BoardLocation::FromSquare(square);
+    for (Team team : {RED_YELLOW, BLUE_GREEN}) {
+      EXPECT_EQ(board.GetAttackCount(team, location),
+                board.GetAttackersTo(square, team, board.GetOccupied()).Count())
+        << location << " team " << (int)team;
     }
   }
-  return std::nullopt;
 }
 
 }  // namespace
 
+TEST(BoardTest, AttackMaps) {
+  auto board = Board::CreateStandardSetup();
+  board->EnableAttackMaps(true);
+  ExpectAttackMapsMatch(*board);
+
+  board->MakeMove(Move(BoardLocation(12, 7), BoardLocation(11, 7))); // h3
+  board->MakeMove(Move(BoardLocation(7, 1), BoardLocation(7, 2))); // c7
+  board->MakeMove(Move(BoardLocation(1, 6), BoardLocation(2, 6))); // g12
+  board->MakeMove(Move(BoardLocation(6, 12), BoardLocation(6, 11))); // l8
+  board->MakeMove(Move(BoardLocation(13, 6), BoardLocation(7, 12),
+                  board->GetPiece(BoardLocation(7, 12)))); // Qxm7
+  ExpectAttackMapsMatch(*board);
+  EXPECT_TRUE(board->IsKingInCheck(Player(GREEN)));
+
+  for (int i = 0; i < 5; i++) {
+    board->UndoMove();
+  }
+  ExpectAttackMapsMatch(*board);
+  EXPECT_FALSE(board->IsKingInCheck(Player(GREEN)));
+}
+
+//TEST(BoardTest, Enpassant) {
+//  auto board = 
+//}
+
 TEST(BoardTest, MakeAndUndoMoves) {
   auto board = ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,0,1,1-0,0,0,0-2-x,x,x,yR,yN,1,yK,1,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yP,yP,yP,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,2,bP,8,gP,1/bQ,bP,9,gP,1,gK/bK,bP,bP,1,yQ,7,gP,1/bB,11,gP,gB/bN,1,bP,6,gB,2,gP,gN/3,bR,1,rP,6,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,1,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,1,rB,rQ,rK,1,rN,rR,x,x,x");
 
@@ -1595,6 +1890,79 @@ TEST(BoardTest, MakeAndUndoMoves) {
   EXPECT_EQ(hash, board->HashKey());
 }
 
+TEST(BoardTest, PieceSquareEvaluation) {
+  static PieceSquareTable table;
+  for (int color = 0; color < 4; color++) {
+    for (int piece_type = 0; piece_type < 6; piece_type++) {
+      for (int row = 0; row < 14; row++) {
+        for (int col = 0; col < 14; col++) {
+          table[color][piece_type][row][col] =
+            (color + 1) * (piece_type + 1) * (row * 14 + col);
+        }
+      }
+    }
+  }
+
+  auto board = ParseBoardFromFEN("R-0,0,0,0-1,0,1,1-1,0,1,1-0,0,0,0-2-x,x,x,yR,yN,1,yK,1,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yP,yP,yP,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,2,bP,8,gP,1/bQ,bP,9,gP,1,gK/bK,bP,bP,1,yQ,7,gP,1/bB,11,gP,gB/bN,1,bP,6,gB,2,gP,gN/3,bR,1,rP,6,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,1,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,1,rB,rQ,rK,1,rN,rR,x,x,x");
+  EXPECT_EQ(0, board->PieceSquareEvaluation());
+  board->SetPieceSquareTable(&table);
+
+  auto expected = [&](PlayerColor color) {
+    int sum = 0;
+    for (const auto& placed_piece : board->GetPieceList()[color]) {
+      const auto& loc = placed_piece.GetLocation();
+      sum += table[color][placed_piece.GetPiece().GetPieceType()]
+        [loc.GetRow()][loc.GetCol()];
+    }
+    return sum;
+  };
+
+  Move moves[300];
+  for (int i = 0; i < 8; i++) {
+    for (int color = 0; color < 4; color++) {
+      PlayerColor pl_cl = static_cast<PlayerColor>(color);
+      EXPECT_EQ(expected(pl_cl), board->PieceSquareEvaluation(pl_cl));
+    }
+    EXPECT_EQ(expected(RED) + expected(YELLOW)
+              - expected(BLUE) - expected(GREEN),
+              board->PieceSquareEvaluation());
+    size_t num_moves = board->GetCaptureMoves(moves, 300);
+    if (num_moves == 0) {
+      num_moves = board->GetLegalMoves(moves, 300);
+    }
+    board->MakeMove(moves[0]);
+  }
+  board->SetPieceSquareTable(nullptr);
+  EXPECT_EQ(0, board->PieceSquareEvaluation());
+}
+
+TEST(BoardTest, UndoStack) {
+  auto board = ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,2,yK,3,yR,x,x,x/x,x,x,yP,yP,yP,yP,yP,yP,yP,yP,x,x,x/x,x,x,8,x,x,x/bR,bP,10,gP,gR/1,bP,10,gP,1/1,bP,10,gP,1/1,bP,4,bR,5,gP,gK/bK,bP,10,gP,1/1,bP,10,gP,1/1,bP,10,gP,1/bR,bP,10,gP,gR/x,x,x,8,x,x,x/x,x,x,rP,rP,rP,1,rP,rP,rP,rP,x,x,x/x,x,x,rR,3,rK,2,rR,x,x,x");
+  int64_t hash = board->HashKey();
+  Player red(RED);
+  CastlingRights rights = board->GetCastlingRights(red);
+
+  // castle kingside, then capture with blue's rook
+  Move castle = *FindMove(*board, Loc(13, 7), Loc(13, 9));
+  board->MakeMove(castle);
+  EXPECT_EQ(1, board->NumMoves());
+  EXPECT_EQ(castle, board->GetLastMove());
+  EXPECT_FALSE(board->LastMoveWasCapture());
+  EXPECT_FALSE(board->GetCastlingRights(red).Kingside());
+  board->MakeMove(*FindMove(*board, Loc(6, 6), Loc(1, 6)));
+  EXPECT_EQ(2, board->NumMoves());
+  EXPECT_TRUE(board->LastMoveWasCapture());
+  EXPECT_THAT(board->Moves(), ElementsAre(castle, board->GetLastMove()));
+
+  board->UndoMove();
+  board->UndoMove();
+  EXPECT_EQ(0, board->NumMoves());
+  EXPECT_EQ(hash, board->HashKey());
+  EXPECT_EQ(rights, board->GetCastlingRights(red));
+  EXPECT_EQ(Piece(YELLOW, PAWN), board->GetPiece(Loc(1, 6)));
+  EXPECT_EQ(Piece(RED, KING), board->GetPiece(Loc(13, 7)));
+}
+
 namespace {
 
 Move MakeMove(const Board& board, BoardLocation from, BoardLocation to) {
@@ -1667,6 +2035,193 @@ TEST(BoardTest, DeliversCheck) {
   EXPECT_TRUE(move.DeliversCheck(*board));
   EXPECT_TRUE(move.DeliversCheck(*board));
 
+  // Discovered checks: the red knight stands between the red rook and the
+  // blue king.
+  board = ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,yN,yB,yK,yQ,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yP,yP,yP,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,10,gP,gB/bQ,bP,9,gP,1,gK/bK,3,rN,2,rR,4,gP,gQ/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,bP,10,gP,gR/x,x,x,1,rB,2,rP,3,x,x,x/x,x,x,rP,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,2,rB,rQ,rK,1,rN,rR,x,x,x");
+  CheckInfo check_info = board->GetCheckInfo();
+  EXPECT_TRUE(check_info.blockers[0].Test(BoardLocation(7, 4).GetSquare()));
+
+  move = MakeMove(*board, BoardLocation(7, 4), BoardLocation(5, 3));
+  EXPECT_TRUE(board->DeliversCheck(move));
+  EXPECT_TRUE(move.DeliversCheck(*board, check_info));
+
+  move = MakeMove(*board, BoardLocation(7, 7), BoardLocation(7, 5));
+  EXPECT_FALSE(board->DeliversCheck(move));
+  EXPECT_FALSE(move.DeliversCheck(*board, check_info));
+}
+
+TEST(BoardTest, StaticExchangeEvaluation) {
+  std::unordered_map<BoardLocation, Piece> location_to_piece = {
+    {BoardLocation(13, 7), Piece(RED, KING)},
+    {BoardLocation(7, 0), Piece(BLUE, KING)},
+    {BoardLocation(0, 6), Piece(YELLOW, KING)},
+    {BoardLocation(6, 13), Piece(GREEN, KING)},
+    // Doubled red rooks against a blue knight defended by a rook.
+    {BoardLocation(10, 5), Piece(RED, ROOK)},
+    {BoardLocation(12, 5), Piece(RED, ROOK)},
+    {BoardLocation(6, 5), Piece(BLUE, KNIGHT)},
+    {BoardLocation(4, 5), Piece(BLUE, ROOK)},
+    // A green pawn defended by a green knight.
+    {BoardLocation(9, 10), Piece(RED, QUEEN)},
+    {BoardLocation(7, 10), Piece(GREEN, PAWN)},
+    {BoardLocation(5, 11), Piece(GREEN, KNIGHT)},
+  };
+  Board board(Player(RED), location_to_piece);
+
+  // The second rook recaptures through the first: 300 - 500 + 500.
+  Move move(BoardLocation(10, 5), BoardLocation(6, 5),
+            board.GetPiece(BoardLocation(6, 5)));
+  EXPECT_EQ(300, StaticExchangeEvaluationCapture(
+        kPieceEvaluations, board, move));
+  EXPECT_TRUE(StaticExchangeEvaluationGe(kPieceEvaluations, board, move, 300));
+  EXPECT_FALSE(StaticExchangeEvaluationGe(kPieceEvaluations, board, move, 301));
+
+  move = Move(BoardLocation(9, 10), BoardLocation(7, 10),
+              board.GetPiece(BoardLocation(7, 10)));
+  EXPECT_EQ(50 - 1000, StaticExchangeEvaluationCapture(
+        kPieceEvaluations, board, move));
+  EXPECT_FALSE(StaticExchangeEvaluationGe(kPieceEvaluations, board, move, 0));
+
+  // The board is left as it was.
+  EXPECT_EQ(Board(Player(RED), location_to_piece).HashKey(), board.HashKey());
+}
+
+TEST(BoardTest, StaticExchangeEvaluationGe) {
+  std::vector<std::shared_ptr<Board>> boards = {
+    ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,yN,yB,yK,yQ,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yP,yP,yP,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,2,rN,7,gP,gB/bQ,bP,9,gP,1,gK/bK,1,bP,4,rR,4,gP,gQ/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,bP,10,gP,gR/x,x,x,1,rB,2,rP,3,x,x,x/x,x,x,rP,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,2,rB,rQ,rK,1,rN,rR,x,x,x"),
+    ParseBoardFromFEN("Y-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,yN,1,yK,1,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yQ,yP,bQ,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,2,rQ,7,gP,gB/1,bP,9,yB,2/bK,1,bP,9,gP,gK/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,bP,10,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,rN,rB,1,rK,rB,rN,rR,x,x,x"),
+  };
+
+  constexpr size_t kLimit = 300;
+  Move moves[kLimit];
+  Move replies[kLimit];
+  int num_captures = 0;
+  auto expect_matches = [&](Board& board, Move* buffer) {
+    size_t num_moves = board.GetLegalMoves(buffer, kLimit);
+    for (size_t i = 0; i < num_moves; i++) {
+      if (!buffer[i].IsCapture()) {
+        continue;
+      }
+      num_captures++;
+      int see = StaticExchangeEvaluationCapture(
+          kPieceEvaluations, board, buffer[i]);
+      for (int threshold : {-1000, -450, -50, -1, 0, 1, 50, 250, 1000}) {
+        EXPECT_EQ(see >= threshold, StaticExchangeEvaluationGe(
+              kPieceEvaluations, board, buffer[i], threshold))
+          << buffer[i].PrettyStr() << " " << see << " " << threshold;
+      }
+    }
+    return num_moves;
+  };
+  for (auto& board : boards) {
+    ASSERT_NE(nullptr, board);
+    size_t num_moves = expect_matches(*board, moves);
+    for (size_t i = 0; i < num_moves; i++) {
+      const Piece capture = moves[i].GetCapturePiece();
+      if (capture.Present() && capture.GetPieceType() == KING) {
+        continue;
+      }
+      board->MakeMove(moves[i]);
+      expect_matches(*board, replies);
+      board->UndoMove();
+    }
+  }
+  EXPECT_GT(num_captures, 0);
+}
+
+TEST(BoardTest, DeliversCheckMatchesMakeMove) {
+  std::vector<std::shared_ptr<Board>> boards = {
+    Board::CreateStandardSetup(),
+    ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,yN,yB,yK,yQ,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yP,yP,yP,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,2,rN,7,gP,gB/bQ,bP,9,gP,1,gK/bK,1,bP,4,rR,4,gP,gQ/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,bP,10,gP,gR/x,x,x,1,rB,2,rP,3,x,x,x/x,x,x,rP,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,2,rB,rQ,rK,1,rN,rR,x,x,x"),
+    ParseBoardFromFEN("Y-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,yN,1,yK,1,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yQ,yP,bQ,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,2,rQ,7,gP,gB/1,bP,9,yB,2/bK,1,bP,9,gP,gK/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,bP,10,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,rN,rB,1,rK,rB,rN,rR,x,x,x"),
+    // Yellow already checks the blue king. Red can castle kingside, or take
+    // the blue pawn en passant, neither of which adds a check.
+    ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,yN,yB,yK,yQ,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,yP,yP,yP,yP,yP,x,x,x/x,x,x,8,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,10,gP,gB/bQ,bP,10,gP,gK/bK,1,yR,9,gP,gQ/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,bP,10,gP,gR/x,x,x,8,x,x,x/x,x,x,rP,rP,rP,rP,rP,rP,rP,rP,x,x,x/x,x,x,rR,rN,rB,rQ,rK,2,rR,x,x,x"),
+    ParseBoardFromFEN("R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-{'enPassant':('','c4:d4','','')}-x,x,x,yR,yN,yB,yK,yQ,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,yP,yP,yP,yP,yP,x,x,x/x,x,x,8,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,10,gP,gB/bQ,bP,10,gP,gK/bK,1,yR,9,gP,gQ/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,2,bP,8,gP,gR/x,x,x,rP,7,x,x,x/x,x,x,1,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,rN,rB,rQ,rK,rB,rN,rR,x,x,x"),
+  };
+
+  // Compare against playing each move, in every position two plies deep: a
+  // move gives check if afterwards the king is attacked by the moved piece
+  // or by a piece that did not attack it before.
+  constexpr size_t kLimit = 300;
+  Move moves[kLimit];
+  Move replies[kLimit];
+  int num_checks = 0;
+  auto expect_matches = [&](Board& board, Move* buffer) {
+    size_t num_moves = board.GetLegalMoves(buffer, kLimit);
+    CheckInfo check_info = board.GetCheckInfo();
+    PlayerColor color = board.GetTurn().GetColor();
+    Team team = board.GetTurn().GetTeam();
+    std::vector<int> king_squares;
+    for (int add = 1; add < 4; add += 2) {
+      auto king_loc = board.GetKingLocation(
+          static_cast<PlayerColor>((color + add) % 4));
+      if (king_loc.Present()) {
+        king_squares.push_back(king_loc.GetSquare());
+      }
+    }
+
+    for (size_t i = 0; i < num_moves; i++) {
+      const Move& move = buffer[i];
+      bool delivers_check = board.DeliversCheck(move, check_info);
+      num_checks += delivers_check;
+      const Piece capture = move.GetCapturePiece();
+      if (capture.Present() && capture.GetPieceType() == KING) {
+        EXPECT_TRUE(delivers_check);
+        continue;
+      }
+
+      std::vector<Bitboard> attackers_before;
+      for (int king_square : king_squares) {
+        attackers_before.push_back(
+            board.GetAttackersTo(king_square, team, board.GetOccupied()));
+      }
+      board.MakeMove(move);
+      bool gives_check = false;
+      for (size_t k = 0; k < king_squares.size(); k++) {
+        Bitboard attackers = board.GetAttackersTo(
+            king_squares[k], team, board.GetOccupied());
+        if (attackers.Test(move.To().GetSquare())
+            || (attackers & ~attackers_before[k]).Any()) {
+          gives_check = true;
+        }
+      }
+      board.UndoMove();
+      EXPECT_EQ(gives_check, delivers_check) << move.PrettyStr();
+    }
+    return num_moves;
+  };
+  for (auto& board : boards) {
+    ASSERT_NE(nullptr, board);
+    size_t num_moves = expect_matches(*board, moves);
+    for (size_t i = 0; i < num_moves; i++) {
+      const Piece capture = moves[i].GetCapturePiece();
+      if (capture.Present() && capture.GetPieceType() == KING) {
+        continue;
+      }
+      board->MakeMove(moves[i]);
+      expect_matches(*board, replies);
+      board->UndoMove();
+    }
+  }
+  EXPECT_GT(num_checks, 0);
+
+  // The castling and en-passant moves above are generated.
+  int num_special = 0;
+  for (size_t b = boards.size() - 2; b < boards.size(); b++) {
+    Board& board = *boards[b];
+    ASSERT_TRUE(board.IsKingInCheck(Player(BLUE)));
+    size_t num_moves = board.GetLegalMoves(moves, kLimit);
+    for (size_t i = 0; i < num_moves; i++) {
+      if (moves[i].GetRookMove().Present()
+          || moves[i].GetEnpassantLocation().Present()) {
+        num_special++;
+        EXPECT_FALSE(board.DeliversCheck(moves[i], board.GetCheckInfo()))
+          << moves[i].PrettyStr();
+      }
+    }
+  }
+  EXPECT_EQ(2, num_special);
 }
 
 TEST(BoardTest, Promotions) {
@@ -1689,6 +2244,177 @@ TEST(BoardTest, Promotions) {
   EXPECT_NE(piece_eval, piece_eval2);
 }
 
+TEST(BoardTest, CountPseudoLegalMoves) {
+  std::vector<std::shared_ptr<Board>> boards = {
+    Board::CreateStandardSetup(),
+    // Promotions, and en passant for yellow.
+    ParseBoardFromFEN("Y-0,0,0,0-0,0,0,1-0,0,1,1-0,0,0,0-0-{'enPassant':('','c8:d8','','')}-x,x,x,1,yN,1,yK,2,yN,yR,x,x,x/x,x,x,1,yP,yP,3,yP,yP,x,x,x/x,x,x,3,yP,1,yP,2,x,x,x/bR,bP,5,yP,4,gP,gR/1,bP,10,gP,gN/bB,bP,10,gP,1/bK,2,bP,7,gP,1,gK/4,rR,7,gP,1/11,gP,2/1,bP,1,yP,9,gN/1,bP,8,gP,1,gP,gR/x,x,x,rP,1,rN,1,rP,gB,2,x,x,x/x,x,x,2,rP,rP,1,rP,2,x,x,x/x,x,x,4,rK,3,x,x,x"),
+    // En passant for red.
+    ParseBoardFromFEN("Y-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-{'enPassant':('','c4:d4','','')}-x,x,x,yR,yN,yB,yK,yQ,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,yP,yP,yP,yP,yP,x,x,x/x,x,x,8,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,10,gP,gB/bQ,bP,10,gP,gK/bK,bP,10,gP,gQ/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,2,bP,8,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,rN,rB,rQ,rK,rB,rN,rR,x,x,x"),
+    ParseBoardFromFEN("Y-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-x,x,x,yR,yN,1,yK,1,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,1,yQ,yP,bQ,yP,x,x,x/x,x,x,3,yP,4,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,2,rQ,7,gP,gB/1,bP,9,yB,2/bK,1,bP,9,gP,gK/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,bP,10,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,rN,rB,1,rK,rB,rN,rR,x,x,x"),
+  };
+
+  // Compare against generating the moves of each color, in every position
+  // one ply deep. Per-piece counts are of moves off the first row.
+  Bitboard piece_move_squares = GetBitboardTables().legal;
+  for (int col = 0; col < 14; col++) {
+    piece_move_squares.Clear(col);
+  }
+  constexpr size_t kLimit = 300;
+  Move moves[kLimit];
+  Move replies[kLimit];
+  int num_threats = 0;
+  auto expect_matches = [&](Board& board) {
+    Player turn = board.GetTurn();
+    for (int color = 0; color < 4; color++) {
+      MoveCounts counts = board.CountPseudoLegalMoves(
+          static_cast<PlayerColor>(color), kPieceEvaluations, 100,
+          piece_move_squares);
+      board.SetPlayer(Player(static_cast<PlayerColor>(color)));
+      size_t num_moves = board.GetPseudoLegalMoves2(replies, kLimit);
+      int expected_threats = 0;
+      int expected_piece_moves[kNumSquares] = {};
+      for (size_t i = 0; i < num_moves; i++) {
+        const Move& move = replies[i];
+        expected_threats += move.IsCapture()
+          && replies[i].ApproxSEE(board, kPieceEvaluations) >= 100;
+        if (board.GetPiece(move.From()).GetPieceType() != PAWN
+            && !move.GetRookMove().Present()
+            && piece_move_squares.Test(move.To().GetSquare())) {
+          expected_piece_moves[move.From().GetSquare()]++;
+        }
+      }
+      board.SetPlayer(turn);
+      EXPECT_EQ((int)num_moves, counts.num_moves);
+      EXPECT_EQ(expected_threats, counts.num_threats);
+      const PieceList& pieces = board.GetPieceList()[color];
+      for (size_t i = 0; i < pieces.size(); i++) {
+        EXPECT_EQ(
+            expected_piece_moves[pieces[i].GetLocation().GetSquare()],
+            counts.piece_moves[i]);
+      }
+      num_threats += expected_threats;
+    }
+  };
+  for (auto& board : boards) {
+    ASSERT_NE(nullptr, board);
+    expect_matches(*board);
+    size_t num_moves = board->GetPseudoLegalMoves2(moves, kLimit);
+    for (size_t i = 0; i < num_moves; i++) {
+      board->MakeMove(moves[i]);
+      expect_matches(*board);
+      board->UndoMove();
+    }
+  }
+  EXPECT_GT(num_threats, 0);
+}
+
+TEST(BoardTest, GetThreats) {
+  std::unordered_map<BoardLocation, Piece> location_to_piece;
+  location_to_piece[BoardLocation(13, 7)] = Piece(RED, KING);
+  location_to_piece[BoardLocation(7, 0)] = Piece(BLUE, KING);
+  location_to_piece[BoardLocation(0, 6)] = Piece(YELLOW, KING);
+  location_to_piece[BoardLocation(6, 13)] = Piece(GREEN, KING);
+  // Attacked by the knight and undefended.
+  location_to_piece[BoardLocation(8, 6)] = Piece(RED, QUEEN);
+  // Attacked by the blue queen and defended by the pawn.
+  location_to_piece[BoardLocation(10, 10)] = Piece(RED, ROOK);
+  location_to_piece[BoardLocation(11, 9)] = Piece(RED, PAWN);
+  // Attacked by the blue queen and undefended.
+  location_to_piece[BoardLocation(4, 7)] = Piece(RED, BISHOP);
+  // Attacked by the bishop, and the queen by the rook. Both are undefended.
+  location_to_piece[BoardLocation(6, 5)] = Piece(BLUE, KNIGHT);
+  location_to_piece[BoardLocation(4, 10)] = Piece(BLUE, QUEEN);
+  Board board(Player(RED), location_to_piece);
+
+  auto squares = [](std::vector<BoardLocation> locations) {
+    Bitboard bitboard;
+    for (const auto& location : locations) {
+      bitboard.Set(location.GetSquare());
+    }
+    return bitboard;
+  };
+
+  Threats threats = board.GetThreats(RED_YELLOW, kPieceEvaluations, 100);
+  EXPECT_EQ(squares({BoardLocation(8, 6)}), threats.by_lesser);
+  EXPECT_EQ(squares({BoardLocation(8, 6), BoardLocation(4, 7)}),
+            threats.hanging);
+
+  threats = board.GetThreats(BLUE_GREEN, kPieceEvaluations, 100);
+  EXPECT_EQ(squares({BoardLocation(4, 10)}), threats.by_lesser);
+  EXPECT_EQ(squares({BoardLocation(6, 5), BoardLocation(4, 10)}),
+            threats.hanging);
+
+  // A bigger margin leaves only the queen attacked by the knight.
+  threats = board.GetThreats(RED_YELLOW, kPieceEvaluations, 600);
+  EXPECT_EQ(squares({BoardLocation(8, 6)}), threats.by_lesser);
+  threats = board.GetThreats(BLUE_GREEN, kPieceEvaluations, 600);
+  EXPECT_TRUE(threats.by_lesser.Empty());
+}
+
+TEST(BoardTest, CopyKeepsMoveHistory) {
+  auto board = Board::CreateStandardSetup();
+  board->MakeMove(Move(BoardLocation(12, 7), BoardLocation(10, 7)));
+  board->MakeMove(Move(BoardLocation(7, 1), BoardLocation(7, 3)));
+  int64_t hash_key = board->HashKey();
+
+  Board copy(*board);
+  EXPECT_EQ(2, copy.NumMoves());
+  EXPECT_EQ(hash_key, copy.HashKey());
+  EXPECT_EQ(board->GetMove(1), copy.GetMove(1));
+
+  // Changing the copy leaves the original as it was.
+  copy.UndoMove();
+  copy.UndoMove();
+  EXPECT_EQ(0, copy.NumMoves());
+  EXPECT_EQ(Board::CreateStandardSetup()->HashKey(), copy.HashKey());
+  EXPECT_EQ(2, board->NumMoves());
+  EXPECT_EQ(hash_key, board->HashKey());
+
+  copy = *board;
+  copy.UndoMove();
+  EXPECT_EQ(board->GetMove(0), copy.GetMove(0));
+  EXPECT_FALSE(board->GetPiece(7, 1).Present());
+  EXPECT_TRUE(copy.GetPiece(7, 1).Present());
+  EXPECT_TRUE(board->GetPiece(7, 3).Present());
+  EXPECT_FALSE(copy.GetPiece(7, 3).Present());
+}
+
+TEST(BoardTest, LongGameHistory) {
+  // Every player moves a knight out and back, for more plies than the board
+  // keeps inline.
+  const Move knight_moves[4] = {
+    Move(BoardLocation(13, 4), BoardLocation(11, 5)),
+    Move(BoardLocation(4, 0), BoardLocation(5, 2)),
+    Move(BoardLocation(0, 4), BoardLocation(2, 5)),
+    Move(BoardLocation(4, 13), BoardLocation(5, 11)),
+  };
+  auto board = Board::CreateStandardSetup();
+  int64_t start_key = board->HashKey();
+  constexpr int kNumPlies = kInlineUndoPlies + 104;
+  for (int ply = 0; ply < kNumPlies; ply++) {
+    const Move& move = knight_moves[ply % 4];
+    if (ply / 4 % 2 == 0) {
+      board->MakeMove(move);
+    } else {
+      board->MakeMove(Move(move.To(), move.From()));
+    }
+  }
+  EXPECT_EQ(kNumPlies, board->NumMoves());
+  EXPECT_EQ(start_key, board->HashKey());
+  EXPECT_EQ(knight_moves[3], board->GetMove(kNumPlies - 5));
+
+  Board copy(*board);
+  EXPECT_EQ(board->GetLastMove(), copy.GetLastMove());
+  for (int ply = 0; ply < kNumPlies; ply++) {
+    copy.UndoMove();
+  }
+  EXPECT_EQ(0, copy.NumMoves());
+  EXPECT_EQ(start_key, copy.HashKey());
+  EXPECT_TRUE(copy.GetPiece(13, 4).Present());
+  EXPECT_EQ(kNumPlies, board->NumMoves());
+}
+
 
 }  // namespace chess
 
@@ -1,8 +1,10 @@
 #include "command_line.h"
 
+#include <algorithm>
 #include <chrono>
 #include <exception>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -12,6 +14,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "perft.h"
 #include "player.h"
 #include "transposition_table.h"
 #include "board.h"
@@ -54,6 +57,22 @@ std::string GetPVStr(const AlphaBetaPlayer& player) {
   return pv;
 }
 
+std::string GetHashStatsStr(const AlphaBetaPlayer& player) {
+  const auto& stats = player.GetTranspositionTableStats();
+  std::stringstream ss;
+  ss << "hash probes " << stats.probes
+    << " hits " << stats.hits
+    << " misses " << stats.Misses()
+    << " collisions " << stats.collisions
+    << " cutoffs " << stats.cutoffs
+    << " stores " << stats.stores
+    << " replaced_exact " << stats.replaced[EXACT]
+    << " replaced_lower " << stats.replaced[LOWER_BOUND]
+    << " replaced_upper " << stats.replaced[UPPER_BOUND]
+    << " replaced_old " << stats.replaced_old;
+  return ss.str();
+}
+
 }  // namespace
 
 CommandLine::CommandLine() {
@@ -104,6 +123,17 @@ void CommandLine::ResetBoard() {
   board_ = Board::CreateStandardSetup();
 }
 
+void CommandLine::LoadHashFile(const std::string& path) {
+  if (!player_->LoadTranspositionTable(path)) {
+    // The player has emptied the table, so a new game doesn't start with the
+    // previous game's entries.
+    SendInfoMessage("Failed to load hash from " + path);
+  }
+  // The table takes the size of the file.
+  player_options_.transposition_table_size =
+    player_->GetTranspositionTableSize();
+}
+
 void CommandLine::SetEvaluationOptions(const EvaluationOptions& options) {
   std::lock_guard lock(mutex_);
   options_ = options;
@@ -116,6 +146,7 @@ void CommandLine::StartEvaluation() {
     std::shared_ptr<Board> board;
     std::shared_ptr<AlphaBetaPlayer> player;
     EvaluationOptions options;
+    bool debug = false;
     {
       std::lock_guard lock(mutex_);
       if (board_ == nullptr || player_ == nullptr) {
@@ -126,6 +157,7 @@ void CommandLine::StartEvaluation() {
       board = board_;
       player = player_;
       options = options_;
+      debug = debug_;
     }
 
     // if the game is over, print a string showing that
@@ -193,7 +225,11 @@ void CommandLine::StartEvaluation() {
         if (nps.has_value()) {
           std::cout << " nps " << *nps;
         }
+        std::cout << " hashfull " << player->GetHashFull();
         std::cout << std::endl;
+        if (debug) {
+          SendInfoMessage(GetHashStatsStr(*player));
+        }
 
         best_move = std::get<1>(*res);
         if (std::abs(score_centipawn) == kMateValue) {
@@ -233,6 +269,9 @@ void CommandLine::HandleCommand(
     // Allowed options
     std::cout << "option name Hash type spin default 100"
       << std::endl; // size in MB
+    std::cout << "option name Clear Hash type button" << std::endl;
+    std::cout << "option name HashFile type string default <empty>"
+      << std::endl;
     std::cout << "option name UCI_ShowCurrLine type check default false"
       << std::endl;
 
@@ -253,6 +292,12 @@ void CommandLine::HandleCommand(
   } else if (command == "isready") {
     std::cout << "readyok" << std::endl;
   } else if (command == "setoption") {
+    if (parts.size() == 4 && LowerCase(parts[2]) == "clear"
+        && LowerCase(parts[3]) == "hash") {
+      StopEvaluation();
+      player_->ClearTranspositionTable();
+      return;
+    }
     if (parts.size() != 5) {
       SendInvalidCommandMessage(line);
       return;
@@ -267,15 +312,31 @@ void CommandLine::HandleCommand(
               "Hash MB must be non-negative, given: " + option_value);
           return;
         }
-        size_t size = *val * 1000000 / sizeof(HashTableEntry);
+        if (size_t(*val) > std::numeric_limits<size_t>::max() / 1000000) {
+          SendInvalidCommandMessage("Hash MB is too large: " + option_value);
+          return;
+        }
+        size_t size = std::max<size_t>(
+            size_t(*val) * 1000000 / sizeof(HashTableCluster) * kClusterSize,
+            kClusterSize);
         if (size != player_options_.transposition_table_size) {
+          // Resizing needs the table to itself.
+          StopEvaluation();
           player_options_.transposition_table_size = size;
-          player_ = std::make_shared<AlphaBetaPlayer>(player_options_);
+          player_->SetTranspositionTableSize(size);
         }
       } else {
         SendInvalidCommandMessage("Can not parse int: " + option_value);
         return;
       }
+    } else if (option_name == "hashfile") {
+      StopEvaluation();
+      if (option_value == "<empty>") {
+        hash_file_.reset();
+      } else {
+        hash_file_ = option_value;
+        LoadHashFile(*hash_file_);
+      }
     } else if (option_name == "uci_showcurrline") {
       if (option_value == "true") {
         show_current_line_ = true;
@@ -332,11 +393,65 @@ void CommandLine::HandleCommand(
     int n_legal = player_->GetNumLegalMoves(*board_);
     SendInfoMessage("n_legal " + std::to_string(n_legal));
 
+  } else if (command == "perft") {
+    // perft <depth> [divide] [hash <MB>]
+    if (parts.size() < 2) {
+      SendInvalidCommandMessage(line);
+      return;
+    }
+    auto depth = ParseInt(parts[1]);
+    if (!depth.has_value() || *depth < 0) {
+      SendInvalidCommandMessage("Invalid perft depth: " + parts[1]);
+      return;
+    }
+    PerftOptions options;
+    options.num_threads = player_options_.num_threads;
+    size_t cmd_id = 2;
+    while (cmd_id < parts.size()) {
+      if (parts[cmd_id] == "divide") {
+        options.divide = true;
+        cmd_id++;
+      } else if (parts[cmd_id] == "hash" && cmd_id + 1 < parts.size()) {
+        auto megabytes = ParseInt(parts[cmd_id + 1]);
+        if (!megabytes.has_value() || *megabytes < 0) {
+          SendInvalidCommandMessage("Invalid perft hash MB: "
+              + parts[cmd_id + 1]);
+          return;
+        }
+        options.hash_table_size = PerftHashTable::SizeForMegabytes(
+            *megabytes);
+        cmd_id += 2;
+      } else {
+        SendInvalidCommandMessage(line);
+        return;
+      }
+    }
+    StopEvaluation();
+    PrintPerftResult(std::cout, RunPerft(*board_, *depth, options));
+
   } else if (command == "register") {
     // ignore
+  } else if (command == "savehash" || command == "loadhash") {
+    // savehash <path>, loadhash <path>
+    if (parts.size() != 2) {
+      SendInvalidCommandMessage(line);
+      return;
+    }
+    StopEvaluation();
+    if (command == "loadhash") {
+      LoadHashFile(parts[1]);
+    } else if (!player_->SaveTranspositionTable(parts[1])) {
+      SendInfoMessage("Failed to save hash to " + parts[1]);
+    }
+
   } else if (command == "ucinewgame") {
-    // stop evaluation, if any, and create a new player / board
+    // stop evaluation, if any, and reset the board and the hash table
     StopEvaluation();
+    if (hash_file_.has_value()) {
+      LoadHashFile(*hash_file_);
+    } else {
+      player_->ClearTranspositionTable();
+    }
     ResetBoard();
   } else if (command == "position") {
 
@@ -53,6 +53,7 @@ class CommandLine {
       const std::string& line,
       const std::vector<std::string>& parts);
   void SetBoard(std::shared_ptr<Board> board);
+  void LoadHashFile(const std::string& path);
 
   std::mutex mutex_;
 
@@ -68,6 +69,9 @@ class CommandLine {
   EvaluationOptions options_;
   //int n_threads_ = 1;
   bool show_current_line_ = true;
+  // Transposition table file loaded by the HashFile option and at the start
+  // of each game.
+  std::optional<std::string> hash_file_;
   PlayerOptions player_options_;
 };
 
@@ -11,12 +11,14 @@
 #include "board.h"
 #include "utils.h"
 #include "player.h"
+#include "position_file.h"
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 
 ABSL_FLAG(std::string, fens_filepath, "",
-    "FENs filepath. The program will sample positions from this file.");
+    "FENs filepath, or a position file written by fen_to_positions. The "
+    "program will sample positions from this file.");
 ABSL_FLAG(int32_t, num_fens, 100, "Number of FENs to sample");
 ABSL_FLAG(int32_t, move_ms, 250, "Move time in milliseconds");
 ABSL_FLAG(int32_t, num_threads, 12, "Number of threads");
@@ -66,8 +68,11 @@ class Runner {
       std::cout << "FENs filepath not found: " << fens_filepath << std::endl;
       abort();
     }
-    fens_ = ParseFENs(fens_filepath);
-    std::cout << "# FENs: " << fens_.size() << std::endl;
+    positions_ = PositionFileReader::Open(fens_filepath);
+    if (positions_ == nullptr) {
+      fens_ = ParseFENs(fens_filepath);
+    }
+    std::cout << "# FENs: " << NumPositions() << std::endl;
     move_ms_ = absl::GetFlag(FLAGS_move_ms);
     std::cout << "move ms: " << move_ms_ << std::endl;
     num_fens_ = absl::GetFlag(FLAGS_num_fens);
@@ -91,8 +96,7 @@ class Runner {
   void SearchThread() {
     while (true) {
       int fen_id = fen_id_.fetch_add(1);
-      const std::string& fen = fens_[fen_id % fens_.size()];
-      auto board = ParseBoardFromFEN(fen);
+      auto board = GetPosition(fen_id % NumPositions());
       if (board == nullptr) {
         continue;
       }
@@ -109,6 +113,21 @@ class Runner {
     }
   }
 
+  size_t NumPositions() const {
+    return positions_ != nullptr ? positions_->size() : fens_.size();
+  }
+
+  std::shared_ptr<Board> GetPosition(size_t i) const {
+    if (positions_ == nullptr) {
+      return ParseBoardFromFEN(fens_[i]);
+    }
+    auto board = Board::CreateStandardSetup();
+    if (!UnpackPosition((*positions_)[i], *board)) {
+      return nullptr;
+    }
+    return board;
+  }
+
   void Report() {
     std::lock_guard<std::mutex> lock(mutex_);
     float avg_depth = (float)total_depth_ / (float)num_fens_processed_;
@@ -118,6 +137,7 @@ class Runner {
  private:
   std::mutex mutex_;
   std::vector<std::string> fens_;
+  std::unique_ptr<PositionFileReader> positions_;
   int move_ms_ = 0;
   int num_fens_ = 0;
   int total_depth_ = 0;
@@ -0,0 +1,82 @@
+// Converts a file of FENs to a binary position file (see position_file.h).
+//
+// Usage: fen_to_positions <fens_path> <positions_path>
+//
+// Each input line is a FEN, optionally followed by a score in centipawns
+// for the RY team and a result for the RY team: 1 (win), 0 (loss) or 0.5
+// (draw), separated by whitespace. Lines that do not parse, or whose score
+// does not fit in 16 bits, are skipped.
+
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "position_file.h"
+#include "utils.h"
+
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    std::cout << "Usage: " << argv[0] << " <fens_path> <positions_path>"
+      << std::endl;
+    return 1;
+  }
+
+  std::ifstream infile(argv[1]);
+  if (!infile.good()) {
+    std::cout << "Cannot read " << argv[1] << std::endl;
+    return 1;
+  }
+  auto writer = chess::PositionFileWriter::Create(argv[2]);
+  if (writer == nullptr) {
+    std::cout << "Cannot create " << argv[2] << std::endl;
+    return 1;
+  }
+
+  auto board = chess::Board::CreateStandardSetup();
+  std::string line;
+  int64_t num_skipped = 0;
+  while (std::getline(infile, line)) {
+    std::vector<std::string> parts = chess::SplitStrOnWhitespace(line);
+    if (parts.empty()) {
+      continue;
+    }
+    std::optional<int> score;
+    chess::GameResult result = chess::IN_PROGRESS;
+    bool valid = parts.size() <= 3 && chess::ParseFEN(parts[0], *board);
+    if (valid && parts.size() > 1) {
+      score = chess::ParseInt(parts[1]);
+      valid = score.has_value();
+    }
+    if (valid && parts.size() > 2) {
+      if (parts[2] == "1") {
+        result = chess::WIN_RY;
+      } else if (parts[2] == "0") {
+        result = chess::WIN_BG;
+      } else if (parts[2] == "0.5") {
+        result = chess::STALEMATE;
+      } else {
+        valid = false;
+      }
+    }
+
+    chess::PositionRecord record;
+    if (!valid
+        || !chess::PackPosition(*board, record, score, result)
+        || !writer->Write(record)) {
+      num_skipped++;
+      continue;
+    }
+  }
+
+  uint64_t num_records = writer->NumRecords();
+  if (!writer->Close()) {
+    std::cout << "Failed to write " << argv[2] << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << num_records << " positions, skipped "
+    << num_skipped << " lines" << std::endl;
+  return 0;
+}
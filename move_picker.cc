@@ -24,15 +24,23 @@ MovePicker::MovePicker(
     bool enable_move_order_checks,
     Move* buffer,
     size_t buffer_size
-    ,Move* counter_moves
+    ,PackedMove* counter_moves
     ,bool include_quiets
     ,const PieceToHistory** piece_to_history
+    ,const Threats* threats
     ) {
   enable_move_order_checks_ = enable_move_order_checks;
   stages_.resize(5);
   moves_ = buffer;
-  num_moves_ = board.GetPseudoLegalMoves2(buffer, buffer_size);
+  num_moves_ = include_quiets
+    ? board.GetLegalMoves(buffer, buffer_size)
+    : board.GetCaptureMoves(buffer, buffer_size);
   board_ = &board;
+  check_info_ = board.GetCheckInfo();
+  Bitboard threatened;
+  if (threats != nullptr) {
+    threatened = threats->by_lesser | threats->hanging;
+  }
 
   for (size_t i = 0; i < num_moves_; i++) {
     auto& move = moves_[i];
@@ -66,8 +74,8 @@ MovePicker::MovePicker(
       }
     } else if (include_quiets) {
       score += history_heuristic[piece.GetPieceType()][from.GetRow()][from.GetCol()][to.GetRow()][to.GetCol()] / 2;
-      if (move == counter_moves[from.GetRow()*14*14*14 + from.GetCol()*14*14
-          + to.GetRow()*14 + to.GetCol()]) {
+      if (counter_moves[from.GetRow()*14*14*14 + from.GetCol()*14*14
+          + to.GetRow()*14 + to.GetCol()] == move) {
         score += 50;
       }
       score += (*piece_to_history[0])[piece_type][to.GetRow()][to.GetCol()] / 2;
@@ -75,6 +83,9 @@ MovePicker::MovePicker(
       score += (*piece_to_history[2])[piece_type][to.GetRow()][to.GetCol()] / 4;
       score += (*piece_to_history[3])[piece_type][to.GetRow()][to.GetCol()] / 4;
       score += (*piece_to_history[4])[piece_type][to.GetRow()][to.GetCol()] / 4;
+      if (threatened.Test(from.GetSquare())) {
+        score += piece_evaluations[piece_type] / 10;
+      }
 
       stages_[QUIET].emplace_back(i, score);
     }
@@ -98,7 +109,7 @@ Move* MovePicker::GetNextMove() {
     if (stage_vec.size() > 1) {
       if (enable_move_order_checks_) {
         for (auto& item : stage_vec) {
-          if (moves_[item.index].DeliversCheck(*board_)) {
+          if (moves_[item.index].DeliversCheck(*board_, check_info_)) {
             item.score += stage_ == QUIET ? 100'000 : 10'00;
           }
         }
@@ -98,14 +98,19 @@ class MovePicker {
     bool enable_move_order_checks,
     Move* buffer,
     size_t buffer_size
-    ,Move* counter_moves
+    ,PackedMove* counter_moves
     ,bool include_quiets = true
     ,const PieceToHistory** piece_to_history = nullptr
+    // If set, quiet moves of the side to move's threatened pieces are
+    // tried first.
+    ,const Threats* threats = nullptr
     );
 
   // If this returns nullptr then there are no more moves
   Move* GetNextMove();
   int GetNumMoves() const { return num_moves_; };
+  // Check info of the position the moves were generated for.
+  const CheckInfo& GetCheckInfo() const { return check_info_; }
 
  private:
   struct Item {
@@ -116,6 +121,7 @@ class MovePicker {
   };
 
   Board* board_ = nullptr;
+  CheckInfo check_info_;
   Move* moves_ = nullptr;
   size_t num_moves_ = 0;
   uint8_t stage_ = 0;
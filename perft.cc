@@ -0,0 +1,177 @@
+#include "perft.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace chess {
+
+namespace {
+
+constexpr size_t kMaxMoves = 300;
+
+uint64_t Mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+bool IsKingCapture(const Move& move) {
+  const Piece capture = move.GetCapturePiece();
+  return capture.Present() && capture.GetPieceType() == KING;
+}
+
+// HashKey() only covers the pieces and the side to move. Castling rights
+// and the two-square moves of the last three plies (which decide en-passant)
+// also change the move tree below a position.
+uint64_t PerftKey(Board& board) {
+  uint64_t rights = 0;
+  for (int color = 0; color < 4; color++) {
+    const auto& castling_rights = board.GetCastlingRights(
+        Player(static_cast<PlayerColor>(color)));
+    rights |= (castling_rights.Kingside() << 1 | castling_rights.Queenside())
+      << (2 * color);
+  }
+  uint64_t key = board.HashKey() ^ Mix(rights + 1);
+
+  int num_moves = board.NumMoves();
+  for (int plies_ago = 1; plies_ago <= 3 && plies_ago <= num_moves;
+       plies_ago++) {
+    const Move& move = board.GetMove(num_moves - plies_ago);
+    if (move.ManhattanDistance() == 2
+        && (move.From().GetRow() == move.To().GetRow()
+            || move.From().GetCol() == move.To().GetCol())) {
+      key ^= Mix((plies_ago << 8 | move.To().GetSquare()) + 0x100000);
+    }
+  }
+  return key;
+}
+
+}  // namespace
+
+PerftHashTable::PerftHashTable(size_t table_size)
+  : entries_(std::make_unique<Entry[]>(table_size)),
+    table_size_(table_size) { }
+
+std::optional<uint64_t> PerftHashTable::Get(uint64_t key, int depth) const {
+  const Entry& entry = entries_[key % table_size_];
+  uint64_t data = entry.data.load(std::memory_order_relaxed);
+  uint64_t check = entry.check.load(std::memory_order_relaxed);
+  if ((check ^ data) != key || (int)(data & 0xFF) != depth) {
+    return std::nullopt;
+  }
+  return data >> 8;
+}
+
+void PerftHashTable::Save(uint64_t key, int depth, uint64_t count) {
+  Entry& entry = entries_[key % table_size_];
+  uint64_t data = count << 8 | (uint64_t)depth;
+  entry.check.store(key ^ data, std::memory_order_relaxed);
+  entry.data.store(data, std::memory_order_relaxed);
+}
+
+uint64_t Perft(Board& board, int depth, PerftHashTable* table) {
+  if (depth <= 0) {
+    return 1;
+  }
+
+  uint64_t key = 0;
+  if (table != nullptr && depth > 1) {
+    key = PerftKey(board);
+    auto count = table->Get(key, depth);
+    if (count.has_value()) {
+      return *count;
+    }
+  }
+
+  Move moves[kMaxMoves];
+  size_t num_moves = board.GetLegalMoves(moves, kMaxMoves);
+  if (depth == 1) {
+    return num_moves;
+  }
+
+  uint64_t nodes = 0;
+  for (size_t i = 0; i < num_moves; i++) {
+    if (IsKingCapture(moves[i])) {
+      nodes++;
+      continue;
+    }
+    board.MakeMove(moves[i]);
+    nodes += Perft(board, depth - 1, table);
+    board.UndoMove();
+  }
+
+  if (table != nullptr) {
+    table->Save(key, depth, nodes);
+  }
+  return nodes;
+}
+
+PerftResult RunPerft(const Board& board, int depth,
+                     const PerftOptions& options) {
+  auto start = std::chrono::steady_clock::now();
+  PerftResult result;
+
+  Board root(board);
+  Move moves[kMaxMoves];
+  size_t num_moves = depth > 0 ? root.GetLegalMoves(moves, kMaxMoves) : 0;
+
+  std::unique_ptr<PerftHashTable> table;
+  if (options.hash_table_size > 0) {
+    table = std::make_unique<PerftHashTable>(options.hash_table_size);
+  }
+
+  std::vector<uint64_t> counts(num_moves);
+  std::atomic<size_t> next_move = 0;
+  auto work = [&]() {
+    Board thread_board(board);
+    while (true) {
+      size_t i = next_move++;
+      if (i >= num_moves) {
+        break;
+      }
+      if (depth == 1 || IsKingCapture(moves[i])) {
+        counts[i] = 1;
+        continue;
+      }
+      thread_board.MakeMove(moves[i]);
+      counts[i] = Perft(thread_board, depth - 1, table.get());
+      thread_board.UndoMove();
+    }
+  };
+
+  int num_threads = std::clamp<int>(options.num_threads, 1,
+                                    std::max<int>(num_moves, 1));
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; i++) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  result.nodes = depth > 0 ? 0 : 1;
+  for (size_t i = 0; i < num_moves; i++) {
+    result.nodes += counts[i];
+    if (options.divide) {
+      result.divide.emplace_back(moves[i], counts[i]);
+    }
+  }
+  result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  return result;
+}
+
+void PrintPerftResult(std::ostream& os, const PerftResult& result) {
+  for (const auto& [move, count] : result.divide) {
+    os << move.PrettyStr() << ": " << count << std::endl;
+  }
+  int64_t ms = std::max<int64_t>(result.duration.count(), 1);
+  os << "nodes " << result.nodes
+     << " time " << result.duration.count()
+     << " nps " << result.nodes * 1000 / ms << std::endl;
+}
+
+}  // namespace chess
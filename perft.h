@@ -0,0 +1,77 @@
+#ifndef _PERFT_H_
+#define _PERFT_H_
+// Counts the leaf nodes of the legal move tree to a fixed depth, to check the
+// move generator against known totals and to benchmark it:
+// https://www.chessprogramming.org/Perft
+//
+// A move that captures a king ends the game, so it counts as a leaf at any
+// depth.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+
+namespace chess {
+
+// Leaf counts by (position, remaining depth). Safe to share between threads:
+// each slot stores the key xor-ed with its data, so a torn write is read
+// back as a miss rather than as a wrong count.
+class PerftHashTable {
+ public:
+  explicit PerftHashTable(size_t table_size);
+
+  // Number of entries that fit in the given number of megabytes.
+  static size_t SizeForMegabytes(size_t megabytes) {
+    return megabytes * 1000000 / sizeof(Entry);
+  }
+
+  std::optional<uint64_t> Get(uint64_t key, int depth) const;
+  void Save(uint64_t key, int depth, uint64_t count);
+
+ private:
+  struct Entry {
+    std::atomic<uint64_t> check;
+    // count << 8 | depth
+    std::atomic<uint64_t> data;
+  };
+
+  std::unique_ptr<Entry[]> entries_;
+  size_t table_size_ = 0;
+};
+
+struct PerftOptions {
+  int num_threads = 1;
+  // Number of hash table entries. 0 disables the table.
+  size_t hash_table_size = 0;
+  // Also report the count below each root move.
+  bool divide = false;
+};
+
+struct PerftResult {
+  uint64_t nodes = 0;
+  std::vector<std::pair<Move, uint64_t>> divide;
+  std::chrono::milliseconds duration{0};
+};
+
+// Single-threaded count. At depth 1 the legal moves are counted without
+// being made.
+uint64_t Perft(Board& board, int depth, PerftHashTable* table = nullptr);
+
+// Splits the root moves across options.num_threads threads, each working on
+// its own copy of the board.
+PerftResult RunPerft(const Board& board, int depth,
+                     const PerftOptions& options);
+
+// Writes the per-move counts, if any, then the totals.
+void PrintPerftResult(std::ostream& os, const PerftResult& result);
+
+}  // namespace chess
+
+#endif  // _PERFT_H_
@@ -0,0 +1,45 @@
+// Runs perft from the command line.
+//
+// Usage: perft <depth> [num_threads] [hash_mb] [fen]
+// Without a FEN the standard starting position is used.
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "board.h"
+#include "perft.h"
+#include "utils.h"
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0]
+      << " <depth> [num_threads] [hash_mb] [fen]" << std::endl;
+    return 1;
+  }
+
+  int depth = std::stoi(argv[1]);
+  chess::PerftOptions options;
+  options.divide = true;
+  if (argc > 2) {
+    options.num_threads = std::stoi(argv[2]);
+  }
+  if (argc > 3) {
+    options.hash_table_size = chess::PerftHashTable::SizeForMegabytes(
+        std::stoul(argv[3]));
+  }
+
+  std::shared_ptr<chess::Board> board;
+  if (argc > 4) {
+    board = chess::ParseBoardFromFEN(argv[4]);
+    if (board == nullptr) {
+      std::cout << "Invalid FEN: " << argv[4] << std::endl;
+      return 1;
+    }
+  } else {
+    board = chess::Board::CreateStandardSetup();
+  }
+
+  chess::PrintPerftResult(std::cout, chess::RunPerft(*board, depth, options));
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "perft.h"
+#include "utils.h"
+
+namespace chess {
+
+namespace {
+
+constexpr char kEnpassantFEN[] = "Y-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-{'enPassant':('','c4:d4','','')}-x,x,x,yR,yN,yB,yK,yQ,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,yP,yP,yP,yP,yP,x,x,x/x,x,x,8,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,10,gP,gB/bQ,bP,10,gP,gK/bK,bP,10,gP,gQ/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,2,bP,8,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,rN,rB,rQ,rK,rB,rN,rR,x,x,x";
+
+}  // namespace
+
+TEST(PerftTest, StartingPosition) {
+  auto board = Board::CreateStandardSetup();
+  EXPECT_EQ(1, Perft(*board, 0));
+  EXPECT_EQ(20, Perft(*board, 1));
+  // Moving red's f-pawn pins a blue pawn against blue's king.
+  EXPECT_EQ(395, Perft(*board, 2));
+  EXPECT_EQ(7800, Perft(*board, 3));
+  EXPECT_EQ(152050, Perft(*board, 4));
+}
+
+TEST(PerftTest, EnpassantPosition) {
+  auto board = ParseBoardFromFEN(kEnpassantFEN);
+  ASSERT_NE(nullptr, board);
+  EXPECT_EQ(20, Perft(*board, 1));
+  EXPECT_EQ(355, Perft(*board, 2));
+  EXPECT_EQ(11535, Perft(*board, 3));
+}
+
+TEST(PerftTest, ThreadsAndHashTable) {
+  auto board = ParseBoardFromFEN(kEnpassantFEN);
+  ASSERT_NE(nullptr, board);
+
+  PerftOptions options;
+  options.divide = true;
+  PerftResult expected = RunPerft(*board, 4, options);
+  EXPECT_EQ(233648, expected.nodes);
+  uint64_t divide_total = 0;
+  for (const auto& [move, count] : expected.divide) {
+    divide_total += count;
+  }
+  EXPECT_EQ(expected.nodes, divide_total);
+
+  options.num_threads = 4;
+  options.hash_table_size = 1 << 16;
+  PerftResult result = RunPerft(*board, 4, options);
+  EXPECT_EQ(expected.nodes, result.nodes);
+  EXPECT_EQ(expected.divide, result.divide);
+
+  // The board passed in is left untouched.
+  EXPECT_EQ(ParseBoardFromFEN(kEnpassantFEN)->HashKey(), board->HashKey());
+}
+
+TEST(PerftTest, HashTable) {
+  PerftHashTable table(1024);
+  EXPECT_EQ(std::nullopt, table.Get(12345, 3));
+  table.Save(12345, 3, 999);
+  EXPECT_EQ(999, table.Get(12345, 3));
+  EXPECT_EQ(std::nullopt, table.Get(12345, 4));
+  EXPECT_EQ(std::nullopt, table.Get(12345 + 1024, 3));
+}
+
+}  // namespace chess
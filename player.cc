@@ -67,6 +67,7 @@ AlphaBetaPlayer::AlphaBetaPlayer(std::optional<PlayerOptions> options) {
     king_attack_weight_[i] = 400;
   }
 
+  std::memset(piece_square_table_, 0, sizeof(piece_square_table_));
   if (options_.enable_piece_square_table) {
     for (int cl = 0; cl < 4; cl++) {
       PlayerColor color = static_cast<PlayerColor>(cl);
@@ -104,7 +105,51 @@ AlphaBetaPlayer::AlphaBetaPlayer(std::optional<PlayerOptions> options) {
     }
   }
 
+  if (options_.enable_piece_square_table
+      || options_.enable_knight_bonus) {
+    // pawn advancement
+    for (int color = 0; color < 4; color++) {
+      for (int row = 0; row < 14; row++) {
+        for (int col = 0; col < 14; col++) {
+          int advancement = 0;
+          switch (color) {
+          case RED:
+            advancement = 12 - row;
+            break;
+          case YELLOW:
+            advancement = row - 1;
+            break;
+          case BLUE:
+            advancement = col - 1;
+            break;
+          case GREEN:
+            advancement = 12 - col;
+            break;
+          default:
+            break;
+          }
+          int bonus = 2 * std::pow(advancement, 2);
+          bonus += std::max(150 * (advancement - 5), 0);
+          piece_square_table_[color][PAWN][row][col] += bonus;
+        }
+      }
+    }
+  }
+
   if (options_.enable_piece_activation) {
+    for (int color = 0; color < 4; color++) {
+      for (int row = 0; row < 14; row++) {
+        for (int col = 0; col < 14; col++) {
+          bool home = (color == RED && row >= 12)
+                   || (color == YELLOW && row <= 1)
+                   || (color == BLUE && col <= 1)
+                   || (color == GREEN && col >= 12);
+          if (!home && IsLegalSquare(row, col)) {
+            activation_squares_[color].Set(14 * row + col);
+          }
+        }
+      }
+    }
     piece_activation_threshold_[KING] = 999;
     piece_activation_threshold_[PAWN] = 999;
     piece_activation_threshold_[NO_PIECE] = 999;
@@ -155,10 +200,14 @@ AlphaBetaPlayer::AlphaBetaPlayer(std::optional<PlayerOptions> options) {
 
 
 ThreadState::ThreadState(
-    PlayerOptions options, const Board& board, const PVInfo& pv_info)
+    PlayerOptions options, const Board& board, const PVInfo& pv_info,
+    const PieceSquareTable* piece_square_table)
   : options_(options), board_(board), pv_info_(pv_info) {
+  board_.EnableAttackMaps(options_.enable_attack_maps);
+  board_.SetPieceSquareTable(piece_square_table);
   move_buffer_ = new Move[kBufferPartitionSize * kBufferNumPartitions];
-  counter_moves = new Move[14*14*14*14];
+  counter_moves = new PackedMove[14*14*14*14];
+  pawn_hash_table_ = new PawnHashEntry[kPawnHashTableSize];
   continuation_history = new ContinuationHistory*[2];
   for (int i = 0; i < 2; i++) {
     continuation_history[i] = new ContinuationHistory[2];
@@ -168,6 +217,7 @@ ThreadState::ThreadState(
 ThreadState::~ThreadState() {
   delete[] move_buffer_;
   delete[] counter_moves;
+  delete[] pawn_hash_table_;
   for (int i = 0; i < 2; i++) {
     delete[] continuation_history[i];
   }
@@ -187,22 +237,77 @@ void ThreadState::ReleaseMoveBufferPartition() {
   buffer_id_--;
 }
 
+const PawnHashEntry& ThreadState::GetPawnHashEntry() {
+  int64_t key = board_.PawnKey();
+  PawnHashEntry& entry = pawn_hash_table_[(uint64_t)key % kPawnHashTableSize];
+  if (entry.valid && entry.key == key) {
+    return entry;
+  }
+
+  // Direction in which a rook of each color looks for pawns ahead of it.
+  constexpr Direction kRookForward[4] = {NORTH, EAST, SOUTH, WEST};
+  const auto& tables = GetBitboardTables();
+  Bitboard pawns;
+  for (int color = 0; color < 4; color++) {
+    pawns |= board_.GetPieces(static_cast<PlayerColor>(color), PAWN);
+  }
+  for (int color = 0; color < 4; color++) {
+    // A pawn blocks the rooks behind it, looking from the rook's side.
+    int backward = 7 - kRookForward[color];
+    Bitboard blocked;
+    Bitboard remaining = pawns;
+    while (remaining.Any()) {
+      int square = remaining.PopLsb();
+      int n = std::min<int>(6, tables.ray_length[backward][square]);
+      for (int i = 0; i < n; i++) {
+        blocked.Set(tables.ray_squares[backward][square][i]);
+      }
+    }
+    entry.rook_open[color] = tables.legal & ~blocked;
+  }
+  entry.key = key;
+  entry.valid = true;
+  return entry;
+}
+
 int AlphaBetaPlayer::GetNumLegalMoves(Board& board) {
   constexpr int kLimit = 300;
   Move moves[kLimit];
-  Player player = board.GetTurn();
-  size_t num_moves = board.GetPseudoLegalMoves2(moves, kLimit);
-  int n_legal = 0;
-  for (size_t i = 0; i < num_moves; i++) {
-    const auto& move = moves[i];
-    board.MakeMove(move);
-    if (!board.IsKingInCheck(player)) { // invalid move
-      n_legal++;
-    }
-    board.UndoMove();
+  return board.GetLegalMoves(moves, kLimit);
+}
+
+void AlphaBetaPlayer::ClearTranspositionTable() {
+  if (transposition_table_ != nullptr) {
+    transposition_table_->Clear(
+        options_.enable_multithreading ? options_.num_threads : 1);
   }
+}
 
-  return n_legal;
+void AlphaBetaPlayer::SetTranspositionTableSize(size_t table_size) {
+  options_.transposition_table_size = table_size;
+  if (transposition_table_ != nullptr) {
+    transposition_table_->Resize(
+        table_size, options_.enable_multithreading ? options_.num_threads : 1);
+  }
+}
+
+bool AlphaBetaPlayer::SaveTranspositionTable(const std::string& path) const {
+  return transposition_table_ != nullptr
+    && transposition_table_->SaveToFile(path);
+}
+
+bool AlphaBetaPlayer::LoadTranspositionTable(const std::string& path) {
+  if (transposition_table_ == nullptr) {
+    return false;
+  }
+  if (!transposition_table_->LoadFromFile(path)) {
+    // Don't carry over entries from before the load.
+    ClearTranspositionTable();
+    return false;
+  }
+  options_.transposition_table_size =
+    transposition_table_->NumClusters() * kClusterSize;
+  return true;
 }
 
 // Alpha-beta search with nega-max framework.
@@ -240,30 +345,34 @@ std::optional<std::tuple<int, std::optional<Move>>> AlphaBetaPlayer::Search(
   bool is_tt_pv = false;
 
   std::optional<Move> tt_move;
-  const HashTableEntry* tte = nullptr;
+  std::optional<HashTableEntry> tte;
   if (options_.enable_transposition_table) {
     int64_t key = board.HashKey();
 
-    tte = transposition_table_->Get(key);
-    if (tte != nullptr) {
-      if (tte->key == key) { // valid entry
-        if (tte->depth >= depth) {
-          num_cache_hits_++;
-          // at non-PV nodes check for an early TT cutoff
-          if (!is_root_node
-              && !is_pv_node
-              && (tte->bound == EXACT
-                || (tte->bound == LOWER_BOUND && tte->score >= beta)
-                || (tte->bound == UPPER_BOUND && tte->score <= alpha))
-             ) {
-
-            return std::make_tuple(
-                std::min(beta, std::max(alpha, tte->score)), tte->move);
-          }
+    tte = transposition_table_->Get(key, &thread_state.tt_stats);
+    if (tte.has_value()) {
+      tt_move = board.UnpackMove(tte->move);
+      if (tte->move.Present() && !tt_move.has_value()) {
+        // the entry is another position's
+        thread_state.tt_stats.collisions++;
+        tte.reset();
+      }
+    }
+    if (tte.has_value()) {
+      if (tte->depth >= depth) {
+        // at non-PV nodes check for an early TT cutoff
+        if (!is_root_node
+            && !is_pv_node
+            && (tte->bound == EXACT
+              || (tte->bound == LOWER_BOUND && tte->score >= beta)
+              || (tte->bound == UPPER_BOUND && tte->score <= alpha))
+           ) {
+          thread_state.tt_stats.cutoffs++;
+          return std::make_tuple(
+              std::min(beta, std::max(alpha, tte->score)), tt_move);
         }
-        tt_move = tte->move;
-        is_tt_pv = tte->is_pv;
       }
+      is_tt_pv = tte->is_pv;
     }
 
   }
@@ -277,7 +386,8 @@ std::optional<std::tuple<int, std::optional<Move>>> AlphaBetaPlayer::Search(
 
     int eval = Evaluate(thread_state, maximizing_player, alpha, beta);
     if (options_.enable_transposition_table) {
-      transposition_table_->Save(board.HashKey(), 0, std::nullopt, eval, EXACT, is_pv_node);
+      transposition_table_->Save(board.HashKey(), 0, std::nullopt, eval, EXACT, is_pv_node,
+          &thread_state.tt_stats);
     }
 
     return std::make_tuple(eval, std::nullopt);
@@ -374,6 +484,11 @@ std::optional<std::tuple<int, std::optional<Move>>> AlphaBetaPlayer::Search(
 
   std::optional<Move> pv_move = pvinfo.GetBestMove();
   Move* moves = thread_state.GetNextMoveBufferPartition();
+  Threats threats;
+  if (options_.enable_threat_move_order) {
+    threats = board.GetThreats(
+        board.GetTurn().GetTeam(), kPieceEvaluations, kThreatThreshold);
+  }
   MovePicker move_picker(
     board,
     pv_move.has_value() ? pv_move : tt_move,
@@ -388,6 +503,7 @@ std::optional<std::tuple<int, std::optional<Move>>> AlphaBetaPlayer::Search(
    , thread_state.counter_moves
    , /*include_quiets=*/true
    , cont_hist
+   , options_.enable_threat_move_order ? &threats : nullptr
     );
 
   bool has_legal_moves = false;
@@ -412,7 +528,8 @@ std::optional<std::tuple<int, std::optional<Move>>> AlphaBetaPlayer::Search(
     std::optional<std::tuple<int, std::optional<Move>>> value_and_move_or;
 
     // this has to be called before the move is made
-    bool delivers_check = move.DeliversCheck(board);
+    bool delivers_check = move.DeliversCheck(
+        board, move_picker.GetCheckInfo());
 
     bool lmr =
       options_.enable_late_move_reduction
@@ -509,12 +626,6 @@ std::optional<std::tuple<int, std::optional<Move>>> AlphaBetaPlayer::Search(
       break;
     }
 
-    if (board.IsKingInCheck(player)) { // invalid move
-      board.UndoMove();
-
-      continue;
-    }
-
     has_legal_moves = true;
 
     ss->move_count = move_count++;
@@ -657,7 +768,8 @@ std::optional<std::tuple<int, std::optional<Move>>> AlphaBetaPlayer::Search(
   if (options_.enable_transposition_table) {
     ScoreBound bound = beta <= alpha ? LOWER_BOUND : is_pv_node &&
       best_move.has_value() ? EXACT : UPPER_BOUND;
-    transposition_table_->Save(board.HashKey(), depth, best_move, score, bound, is_pv_node);
+    transposition_table_->Save(board.HashKey(), depth, best_move, score, bound, is_pv_node,
+        &thread_state.tt_stats);
   }
 
   if (best_move.has_value()
@@ -702,27 +814,31 @@ AlphaBetaPlayer::QSearch(
 
   std::optional<Move> tt_move;
 
-  const HashTableEntry* tte = nullptr;
+  std::optional<HashTableEntry> tte;
   if (options_.enable_transposition_table) {
     int64_t key = board.HashKey();
 
-    tte = transposition_table_->Get(key);
-    if (tte != nullptr) {
-      if (tte->key == key) { // valid entry
-        if (tte->depth >= tt_depth) {
-          num_cache_hits_++;
-          // at non-PV nodes check for an early TT cutoff
-          if (!is_pv_node
-              && (tte->bound == EXACT
-                || (tte->bound == LOWER_BOUND && tte->score >= beta)
-                || (tte->bound == UPPER_BOUND && tte->score <= alpha))
-             ) {
-
-            return std::make_tuple(
-                std::min(beta, std::max(alpha, tte->score)), std::nullopt);
-          }
+    tte = transposition_table_->Get(key, &thread_state.tt_stats);
+    if (tte.has_value()) {
+      tt_move = board.UnpackMove(tte->move);
+      if (tte->move.Present() && !tt_move.has_value()) {
+        // the entry is another position's
+        thread_state.tt_stats.collisions++;
+        tte.reset();
+      }
+    }
+    if (tte.has_value()) {
+      if (tte->depth >= tt_depth) {
+        // at non-PV nodes check for an early TT cutoff
+        if (!is_pv_node
+            && (tte->bound == EXACT
+              || (tte->bound == LOWER_BOUND && tte->score >= beta)
+              || (tte->bound == UPPER_BOUND && tte->score <= alpha))
+           ) {
+          thread_state.tt_stats.cutoffs++;
+          return std::make_tuple(
+              std::min(beta, std::max(alpha, tte->score)), std::nullopt);
         }
-        tt_move = tte->move;
       }
     }
 
@@ -749,7 +865,8 @@ AlphaBetaPlayer::QSearch(
     if (best_value >= beta) {
       if (options_.enable_transposition_table) {
         transposition_table_->Save(
-            board.HashKey(), 0, std::nullopt, best_value, LOWER_BOUND, is_pv_node);
+            board.HashKey(), 0, std::nullopt, best_value, LOWER_BOUND, is_pv_node,
+            &thread_state.tt_stats);
       }
 
       return std::make_tuple(best_value, std::nullopt);
@@ -812,8 +929,8 @@ AlphaBetaPlayer::QSearch(
           // small optimization on SEE calculation
           if (move.GetCapturePiece().GetPieceType() != QUEEN
               && board.GetPiece(move.From()).GetPieceType() != PAWN) {
-            int see = StaticExchangeEvaluationCapture(kPieceEvaluations, board, move);
-            if (see < 0) {
+            if (!StaticExchangeEvaluationGe(
+                  kPieceEvaluations, board, move, 0)) {
               continue;
             }
           }
@@ -829,7 +946,8 @@ AlphaBetaPlayer::QSearch(
     ss->current_move = move;
     ss->continuation_history = &thread_state.continuation_history[ss->in_check][move.IsCapture()][piece_type][move.To().GetRow()][move.To().GetCol()];
 
-    bool delivers_check = move.DeliversCheck(board);
+    bool delivers_check = move.DeliversCheck(
+        board, move_picker.GetCheckInfo());
     board.MakeMove(move);
     if (board.CheckWasLastMoveKingCapture() != IN_PROGRESS) {
       board.UndoMove();
@@ -840,11 +958,6 @@ AlphaBetaPlayer::QSearch(
       break;
     }
 
-    if (board.IsKingInCheck(player)) { // invalid move
-      board.UndoMove();
-      continue;
-    }
-
     move_count++;
 
     bool is_pv_move = pv_move.has_value() && *pv_move == move;
@@ -936,7 +1049,7 @@ AlphaBetaPlayer::QSearch(
   if (options_.enable_transposition_table) {
     ScoreBound bound = beta <= alpha ? LOWER_BOUND : UPPER_BOUND;
     transposition_table_->Save(board.HashKey(), tt_depth, best_move, score,
-        bound, is_pv_node);
+        bound, is_pv_node, &thread_state.tt_stats);
   }
 
   thread_state.ReleaseMoveBufferPartition();
@@ -966,7 +1079,7 @@ void AlphaBetaPlayer::UpdateStats(
     }
     if (options_.enable_counter_move_heuristic) {
       thread_state.counter_moves[from.GetRow()*14*14*14 + from.GetCol()*14*14
-        + to.GetRow()*14 + to.GetCol()] = move;
+        + to.GetRow()*14 + to.GetCol()] = PackedMove(move);
     }
     UpdateQuietStats(ss, move);
     UpdateContinuationHistories(ss, move, piece.GetPieceType(), bonus);
@@ -1018,7 +1131,7 @@ constexpr int kPieceImbalanceTable[16] = {
   -400, -400, -400, -400, -400, -400, -400, -400,
 };
 
-int GetNumMajorPieces(const std::vector<PlacedPiece>& pieces) {
+int GetNumMajorPieces(const PieceList& pieces) {
   int num_major = 0;
   for (const auto& placed_piece : pieces) {
     PieceType pt = placed_piece.GetPiece().GetPieceType();
@@ -1054,60 +1167,62 @@ int AlphaBetaPlayer::Evaluate(
       return threat;
     };
 
-    eval += threat_value(thread_state.n_threats[RED],
-                         thread_state.n_threats[YELLOW]);
-    eval -= threat_value(thread_state.n_threats[BLUE],
-                         thread_state.n_threats[GREEN]);
+    if (options_.enable_attack_map_threats) {
+      // Each team threatens the other team's pieces.
+      auto num_threatened = [&board](Team team) {
+        Threats threats = board.GetThreats(
+            team, kPieceEvaluations, kThreatThreshold);
+        return (threats.by_lesser | threats.hanging).Count();
+      };
+      eval += threat_value(num_threatened(BLUE_GREEN), 0);
+      eval -= threat_value(num_threatened(RED_YELLOW), 0);
+    } else {
+      eval += threat_value(thread_state.n_threats[RED],
+                           thread_state.n_threats[YELLOW]);
+      eval -= threat_value(thread_state.n_threats[BLUE],
+                           thread_state.n_threats[GREEN]);
+    }
 
     int n_queen_ry = 0;
     int n_queen_bg = 0;
     if (options_.enable_piece_square_table
         || options_.enable_knight_bonus) {
-      const auto& piece_list = board.GetPieceList();
+      // Piece-square table and pawn advancement, summed by the board.
+      eval += board.PieceSquareEvaluation();
+
+      const PawnHashEntry* pawn_entry = options_.enable_pawn_hash
+        ? &thread_state.GetPawnHashEntry() : nullptr;
+
       for (int color = 0; color < 4; color++) {
-        for (const auto& placed_piece : piece_list[color]) {
-          PieceType piece_type = placed_piece.GetPiece().GetPieceType();
-          const auto& loc = placed_piece.GetLocation();
+        PlayerColor player_color = static_cast<PlayerColor>(color);
+        int n_queens = board.GetPieces(player_color, QUEEN).Count();
+        if (color == RED || color == YELLOW) {
+          n_queen_ry += n_queens;
+        } else {
+          n_queen_bg += n_queens;
+        }
+
+        // Rooks and knights also depend on the pawns and the kings.
+        Bitboard pieces = board.GetPieces(player_color, ROOK);
+        if (options_.enable_knight_bonus) {
+          pieces |= board.GetPieces(player_color, KNIGHT);
+        }
+        while (pieces.Any()) {
+          const auto loc = BoardLocation::FromSquare(pieces.PopLsb());
+          PieceType piece_type = board.GetPiece(loc).GetPieceType();
           int row = loc.GetRow();
           int col = loc.GetCol();
 
-          if (piece_type == QUEEN) {
-            if (color == RED || color == YELLOW) {
-              n_queen_ry++;
-            } else {
-              n_queen_bg++;
-            }
-          } else if (piece_type == PAWN) {
-            int advancement = 0;
-            switch (color) {
-            case RED:
-              advancement = 12 - row;
-              break;
-            case YELLOW:
-              advancement = row - 1;
-              break;
-            case BLUE:
-              advancement = col - 1;
-              break;
-            case GREEN:
-              advancement = 12 - col;
-              break;
-            default:
-              break;
-            }
-            int bonus = 2 * std::pow(advancement, 2);
-            bonus += std::max(150 * (advancement - 5), 0);
-            if (color == RED || color == YELLOW) {
-              eval += bonus;
-            } else {
-              eval -= bonus;
-            }
-          } else if (piece_type == ROOK) {
+          if (piece_type == ROOK) {
             int rook_bonus = 0;
             constexpr int kRookBonus1 = 50;
             constexpr int kRookBonus2 = 25;
             if (col >= 4 && col <= 10 && row >= 4 && row <= 10) {
               rook_bonus = kRookBonus1;
+            } else if (pawn_entry != nullptr) {
+              if (pawn_entry->rook_open[color].Test(loc.GetSquare())) {
+                rook_bonus = kRookBonus2;
+              }
             } else {
               int delta_row = color == RED ? -1 : color == YELLOW ? 1 : 0;
               int delta_col = color == BLUE ? 1 : color == GREEN ? -1: 0;
@@ -1133,19 +1248,8 @@ int AlphaBetaPlayer::Evaluate(
             } else {
               eval -= rook_bonus;
             }
-          }
-
-          if (options_.enable_piece_square_table) {
-            if (color == RED || color == YELLOW) {
-              eval += piece_square_table_[color][piece_type][row][col];
-            } else {
-              eval -= piece_square_table_[color][piece_type][row][col];
-            }
-          }
-
-          // bonus for knights 2 moves away from enemy king
-          if (options_.enable_knight_bonus
-              && piece_type == KNIGHT) {
+          } else {
+            // bonus for knights 2 moves away from enemy king
             int knight_bonus = 0;
             for (int i = 0; i < 2; i++) {
               PlayerColor other_color = static_cast<PlayerColor>(
@@ -1416,7 +1520,7 @@ void AlphaBetaPlayer::ResetMobilityScores(ThreadState& thread_state) {
 
 int AlphaBetaPlayer::StaticEvaluation(Board& board) {
   auto pv_copy = pv_info_.Copy();
-  ThreadState thread_state(options_, board, *pv_copy);
+  ThreadState thread_state(options_, board, *pv_copy, &piece_square_table_);
   ResetMobilityScores(thread_state);
   return Evaluate(thread_state, true, -kMateValue, kMateValue);
 }
@@ -1433,6 +1537,10 @@ AlphaBetaPlayer::MakeMove(
     asp_nobs_ = 0;
     asp_sum_ = 0;
     asp_sum_sq_ = 0;
+    // Repeated calls on the same position deepen one search.
+    if (options_.enable_transposition_table) {
+      transposition_table_->NewSearch();
+    }
   }
   last_board_key_ = hash_key;
 
@@ -1457,7 +1565,8 @@ AlphaBetaPlayer::MakeMove(
   thread_states.reserve(num_threads);
   for (int i = 0; i < num_threads; i++) {
     auto pv_copy = pv_info_.Copy();
-    thread_states.emplace_back(options_, board, *pv_copy);
+    thread_states.emplace_back(options_, board, *pv_copy,
+                               &piece_square_table_);
     auto& thread_state = thread_states.back();
     ResetMobilityScores(thread_state);
     thread_state.ResetHistoryHeuristic();
@@ -1486,6 +1595,12 @@ AlphaBetaPlayer::MakeMove(
     thread->join();
   }
 
+  tt_stats_ = TranspositionTableStats();
+  for (const auto& thread_state : thread_states) {
+    tt_stats_ += thread_state.tt_stats;
+  }
+  num_cache_hits_ += tt_stats_.hits;
+
   SetCanceled(false);
   return res;
 }
@@ -1624,19 +1739,21 @@ int PVInfo::GetDepth() const {
 void AlphaBetaPlayer::UpdateMobilityEvaluation(
     ThreadState& thread_state, Player player) {
   Board& board = thread_state.GetBoard();
-
-  Move* moves = thread_state.GetNextMoveBufferPartition();
-  Player curr_player = board.GetTurn();
-  board.SetPlayer(player);
-  size_t num_moves = board.GetPseudoLegalMoves2(
-      moves, kBufferPartitionSize);
   int color = player.GetColor();
-  thread_state.TotalMoves()[color] = num_moves;
+
+  // don't count back rank squares in mobility / activation
+  MoveCounts counts = board.CountPseudoLegalMoves(
+      player.GetColor(), kPieceEvaluations, kThreatThreshold,
+      activation_squares_[color]);
+  thread_state.TotalMoves()[color] = counts.num_moves;
 
   if (options_.enable_piece_activation) {
     auto piece_activated = [this](
         int color, PieceType piece_type,
         const BoardLocation& location, int n_moves) {
+      if (n_moves == 0) {
+        return false;
+      }
       if (piece_type == KNIGHT) {
         // activated so long as it's not on the back rank
         int row = location.GetRow();
@@ -1650,76 +1767,20 @@ void AlphaBetaPlayer::UpdateMobilityEvaluation(
       return n_moves >= piece_activation_threshold_[piece_type];
     };
 
-    // note: this computation is dependent on the implementation of
-    // Board::GetPseudoLegalMoves2, which adds all moves for a given
-    // piece/location at a time.
-    BoardLocation last_loc = BoardLocation::kNoLocation;
-    PieceType last_piece_type = NO_PIECE;
     int n_pieces_activated = 0;
-    int n_moves = 0;
-    int n_threats = 0;
-    for (size_t move_id = 0; move_id < num_moves; move_id++) {
-      auto& move = moves[move_id];
-      const auto& from = move.From();
-      const auto& to = move.To();
-      const auto& piece = board.GetPiece(from);
-      PieceType piece_type = piece.GetPieceType();
-
-      if (move.IsCapture()) {
-        int see = move.ApproxSEE(board, kPieceEvaluations);
-        if (see >= 100) {
-          n_threats++;
-        }
-      }
-
-      // don't count back rank squares in mobility / activation
-      switch (piece.GetColor()) {
-      case RED:
-        if (to.GetRow() >= 12) {
-          continue;
-        }
-        break;
-      case YELLOW:
-        if (to.GetRow() <= 1) {
-          continue;
-        }
-        break;
-      case BLUE:
-        if (to.GetCol() <= 1) {
-          continue;
-        }
-        break;
-      case GREEN:
-        if (to.GetCol() >= 12) {
-          continue;
-        }
-        break;
-      default:
-        break;
-      }
-
-      if (piece_type == QUEEN || piece_type == ROOK || piece_type == BISHOP
-          || piece_type == KNIGHT) {
-        if (from != last_loc) {
-          if (piece_activated(color, last_piece_type, last_loc, n_moves)) {
-            n_pieces_activated++;
-          }
-          last_loc = from;
-          last_piece_type = piece_type;
-          n_moves = 0;
-        }
-        n_moves++;
+    const PieceList& pieces = board.GetPieceList()[color];
+    for (size_t i = 0; i < pieces.size(); i++) {
+      PieceType piece_type = pieces[i].GetPiece().GetPieceType();
+      if ((piece_type == QUEEN || piece_type == ROOK || piece_type == BISHOP
+           || piece_type == KNIGHT)
+          && piece_activated(color, piece_type, pieces[i].GetLocation(),
+                             counts.piece_moves[i])) {
+        n_pieces_activated++;
       }
     }
-    if (piece_activated(color, last_piece_type, last_loc, n_moves)) {
-      n_pieces_activated++;
-    }
     thread_state.NActivated()[color] = n_pieces_activated;
-    thread_state.n_threats[color] = n_threats;
+    thread_state.n_threats[color] = counts.num_threats;
   }
-
-  board.SetPlayer(curr_player);
-  thread_state.ReleaseMoveBufferPartition();
 }
 
 bool AlphaBetaPlayer::OnBackRank(
@@ -5,6 +5,7 @@
 #include <chrono>
 #include <memory>
 #include <optional>
+#include <string>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -38,6 +39,9 @@ class PVInfo {
 constexpr size_t kTranspositionTableSize = 2'000'000;
 constexpr int kMaxPly = 300;
 constexpr int kKillersPerPly = 3;
+// A capture counts as a threat in the evaluation if the captured piece is
+// worth at least this much more than the capturing one.
+constexpr int kThreatThreshold = 100;
 
 struct PlayerOptions {
   // for search
@@ -54,6 +58,8 @@ struct PlayerOptions {
   bool enable_history_heuristic = true;
   bool enable_killers = true;
   bool enable_counter_move_heuristic = true;
+  // Try quiet moves of pieces that Board::GetThreats reports first
+  bool enable_threat_move_order = false;
 
   // for evaluation
   bool enable_piece_activation = true;
@@ -65,6 +71,11 @@ struct PlayerOptions {
   bool enable_lazy_eval = true;
   bool enable_piece_square_table = true;
   bool enable_knight_bonus = true;
+  // Cache the pawn-dependent terms by Board::PawnKey (see PawnHashEntry)
+  bool enable_pawn_hash = true;
+  // Count threats with Board::GetThreats instead of from the capture moves
+  // found by UpdateMobilityEvaluation
+  bool enable_attack_map_threats = false;
   Team engine_team = NO_TEAM;
 
   // for pruning / reduction
@@ -77,6 +88,10 @@ struct PlayerOptions {
   bool enable_multithreading = true;
   int num_threads = 8;
 
+  // for move generation
+  // Keep incremental attack counts on the board (see Board::EnableAttackMaps)
+  bool enable_attack_maps = false;
+
   // transposition table
   size_t transposition_table_size = kTranspositionTableSize;
   std::optional<int> max_search_depth;
@@ -100,14 +115,28 @@ enum NodeType {
   Root,
 };
 
+// Evaluation terms that depend only on the pawns, cached per thread by
+// Board::PawnKey.
+struct PawnHashEntry {
+  int64_t key = 0;
+  bool valid = false;
+  // Squares on which a rook of the given color has no pawn (of any color)
+  // within 6 squares ahead of it.
+  Bitboard rook_open[4];
+};
+
+constexpr size_t kPawnHashTableSize = 2048;
+
 constexpr size_t kBufferPartitionSize = 300; // number of elements per buffer partition
 constexpr size_t kBufferNumPartitions = 200; // number of recursive calls
 
 // Manages state of worker threads during search
 class ThreadState {
  public:
+  // `piece_square_table`, if given, is tracked by the thread's board.
   ThreadState(
-      PlayerOptions options, const Board& board, const PVInfo& pv_info);
+      PlayerOptions options, const Board& board, const PVInfo& pv_info,
+      const PieceSquareTable* piece_square_table = nullptr);
   Board& GetBoard() { return board_; }
   Move* GetNextMoveBufferPartition();
   void ReleaseMoveBufferPartition();
@@ -115,6 +144,8 @@ class ThreadState {
   int* TotalMoves() { return total_moves_; }
   PVInfo& GetPVInfo() { return pv_info_; }
   void ResetHistoryHeuristic();
+  // Returns the pawn hash entry for the board's pawns, computing it on a miss.
+  const PawnHashEntry& GetPawnHashEntry();
 
   ~ThreadState();
 
@@ -124,11 +155,12 @@ class ThreadState {
   int capture_heuristic[6][4][6][4][14][14];
   // https://www.chessprogramming.org/Countermove_Heuristic
   // (from_row, from_col, to_row, to_col)
-  Move* counter_moves = nullptr;
+  PackedMove* counter_moves = nullptr;
   // indexed by (in_check, is_capture)
   ContinuationHistory** continuation_history = nullptr;
 
   int n_threats[4] = {0, 0, 0, 0};
+  TranspositionTableStats tt_stats;
 
  private:
   PlayerOptions options_;
@@ -141,6 +173,8 @@ class ThreadState {
   // Id within move_buffer_
   size_t buffer_id_ = 0;
 
+  PawnHashEntry* pawn_hash_table_ = nullptr;
+
   int n_activated_[4] = {0, 0, 0, 0};
   int total_moves_[4] = {0, 0, 0, 0};
 
@@ -192,9 +226,34 @@ class AlphaBetaPlayer {
       PVInfo& pv_info);
 
   int GetNumLegalMoves(Board& board);
+  // Empties the transposition table, e.g. for a new game. Must not be called
+  // during a search.
+  void ClearTranspositionTable();
+  // Resizes the transposition table in place, keeping the rest of the
+  // player's state. Must not be called during a search.
+  void SetTranspositionTableSize(size_t table_size);
+  size_t GetTranspositionTableSize() const {
+    return options_.transposition_table_size;
+  }
+  // Saves the transposition table to a file, or replaces it with one loaded
+  // from a file (see TranspositionTable::SaveToFile). Return false on
+  // failure, or if the table is disabled; a failed load leaves the table
+  // empty. Must not be called during a search.
+  bool SaveTranspositionTable(const std::string& path) const;
+  bool LoadTranspositionTable(const std::string& path);
 
   int64_t GetNumEvaluations() { return num_nodes_; }
   int64_t GetNumCacheHits() { return num_cache_hits_; }
+  // Transposition table activity of the last call to MakeMove.
+  const TranspositionTableStats& GetTranspositionTableStats() const {
+    return tt_stats_;
+  }
+  // UCI hashfull: permille of the transposition table used by the current
+  // search.
+  int GetHashFull() const {
+    return transposition_table_ != nullptr
+      ? transposition_table_->HashFull() : 0;
+  }
   int64_t GetNumNullMovesTried() { return num_null_moves_tried_; }
   int64_t GetNumNullMovesPruned() { return num_null_moves_pruned_; }
   int64_t GetNumFutilityMovesPruned() { return num_futility_moves_pruned_; }
@@ -261,6 +320,7 @@ class AlphaBetaPlayer {
 
   //HashTableEntry* hash_table_ = nullptr;
   std::unique_ptr<TranspositionTable> transposition_table_;
+  TranspositionTableStats tt_stats_;
   PVInfo pv_info_;
 
   bool enable_debug_ = false;
@@ -274,10 +334,14 @@ class AlphaBetaPlayer {
   // For evaluation
   int king_attack_weight_[30];
   int king_attacker_values_[6];
-  // color x piece type x row x col
-  int piece_square_table_[4][6][14][14];
+  // color x piece type x row x col. Also holds the pawn advancement bonus;
+  // the thread boards sum it incrementally.
+  PieceSquareTable piece_square_table_;
   // number of moves a piece needs to have to be considered active
   int piece_activation_threshold_[7];
+  // Squares outside each color's two home ranks, where moves count towards
+  // piece activation.
+  Bitboard activation_squares_[4];
   bool knight_to_king_[14][14][14][14];
   Team root_team_ = NO_TEAM;
 };
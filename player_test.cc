@@ -154,6 +154,23 @@ TEST(PlayerTest, CheckPVInfoProducesValidMoves) {
   EXPECT_GE(num_pvmoves, kDepth);
 }
 
+TEST(PlayerTest, FailedTranspositionTableLoadEmptiesTable) {
+  PlayerOptions options;
+  options.transposition_table_size = 1 << 14;
+  AlphaBetaPlayer player(options);
+
+  auto board = Board::CreateStandardSetup();
+  ASSERT_TRUE(player.MakeMove(*board, std::nullopt, 4).has_value());
+  ASSERT_GT(player.GetHashFull(), 0);
+
+  // As when ucinewgame reloads a HashFile that can't be read.
+  EXPECT_FALSE(player.LoadTranspositionTable(
+        ::testing::TempDir() + "player_test_missing.hash"));
+  EXPECT_EQ(0, player.GetHashFull());
+  EXPECT_EQ(options.transposition_table_size,
+            player.GetTranspositionTableSize());
+}
+
 //TEST(PlayerTest, StaticExchangeEvaluation) {
 //  PlayerOptions options;
 //  AlphaBetaPlayer player(options);
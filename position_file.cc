@@ -0,0 +1,248 @@
+#include "position_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace chess {
+
+namespace {
+
+// Offset from the square a pawn of each color lands on after a two-square
+// move back to the square it started from.
+constexpr int kDoublePushBack[4][2] = {
+  {2, 0},   // RED
+  {0, -2},  // BLUE
+  {-2, 0},  // YELLOW
+  {0, 2},   // GREEN
+};
+
+bool IsTwoSquarePawnMove(const Board& board, const Move& move,
+                         PlayerColor color) {
+  const Piece piece = board.GetPiece(move.To());
+  return piece.Present()
+    && piece.GetColor() == color
+    && piece.GetPieceType() == PAWN
+    && move.ManhattanDistance() == 2
+    && (move.From().GetRow() == move.To().GetRow()
+        || move.From().GetCol() == move.To().GetCol());
+}
+
+bool WriteHeader(std::FILE* file, uint64_t num_records) {
+  PositionFileHeader header = {};
+  std::memcpy(header.magic, kPositionFileMagic, sizeof(kPositionFileMagic));
+  header.version = kPositionFileVersion;
+  header.record_size = sizeof(PositionRecord);
+  header.num_records = num_records;
+  return std::fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+}  // namespace
+
+bool PackPosition(const Board& board, PositionRecord& record,
+                  std::optional<int> score, GameResult result) {
+  std::memset(&record, 0, sizeof(record));
+
+  Bitboard occupied = board.GetOccupied();
+  if (occupied.Count() > kMaxRecordPieces
+      || (score.has_value()
+          && (*score < std::numeric_limits<int16_t>::min()
+              || *score > std::numeric_limits<int16_t>::max()))) {
+    return false;
+  }
+  for (int i = 0; i < 4; i++) {
+    record.occupied[i] = occupied.Lane(i);
+  }
+  int num_pieces = 0;
+  while (occupied.Any()) {
+    const Piece& piece = board.GetPiece(
+        BoardLocation::FromSquare(occupied.PopLsb()));
+    record.pieces[num_pieces++] = piece.GetColor() << 3 | piece.GetPieceType();
+  }
+
+  PlayerColor turn = board.GetTurn().GetColor();
+  record.turn = turn;
+  for (int color = 0; color < 4; color++) {
+    const auto& rights = board.GetCastlingRights(
+        Player(static_cast<PlayerColor>(color)));
+    record.castling |= (rights.Kingside() << (2 * color))
+      | (rights.Queenside() << (2 * color + 1));
+  }
+
+  // The same lookup as in GetPawnMoves2: a color's last move comes from the
+  // move history if it is there, and from the initial state otherwise.
+  for (int color = 0; color < 4; color++) {
+    record.enp_to[color] = kNumSquares;
+    int n_turns = (4 + turn - color) % 4;
+    if (n_turns == 0) {
+      continue;
+    }
+    std::optional<Move> last_move;
+    if (n_turns <= board.NumMoves()) {
+      last_move = board.GetMove(board.NumMoves() - n_turns);
+    } else {
+      last_move = board.GetEnpassantInitialization().enp_moves[color];
+    }
+    if (last_move.has_value()
+        && IsTwoSquarePawnMove(board, *last_move,
+                               static_cast<PlayerColor>(color))) {
+      record.enp_to[color] = last_move->To().GetSquare();
+    }
+  }
+
+  record.result = result;
+  record.has_score = score.has_value();
+  record.score = score.value_or(0);
+  return true;
+}
+
+bool UnpackPosition(const PositionRecord& record, Board& board) {
+  if (record.turn >= 4) {
+    return false;
+  }
+  const auto& tables = GetBitboardTables();
+  Bitboard occupied(record.occupied[0], record.occupied[1],
+                    record.occupied[2], record.occupied[3]);
+  if (occupied.Count() > kMaxRecordPieces
+      || (occupied & ~tables.legal).Any()) {
+    return false;
+  }
+
+  Piece pieces[14][14];
+  int num_pieces = 0;
+  size_t num_color_pieces[4] = {0, 0, 0, 0};
+  while (occupied.Any()) {
+    BoardLocation location = BoardLocation::FromSquare(occupied.PopLsb());
+    uint8_t code = record.pieces[num_pieces++];
+    int color = code >> 3;
+    int piece_type = code & 7;
+    if (color >= 4
+        || piece_type > KING
+        || ++num_color_pieces[color] > PieceList::kCapacity) {
+      return false;
+    }
+    pieces[location.GetRow()][location.GetCol()] = Piece(
+        static_cast<PlayerColor>(color), static_cast<PieceType>(piece_type));
+  }
+
+  CastlingRights castling_rights[4];
+  for (int color = 0; color < 4; color++) {
+    castling_rights[color] = CastlingRights(
+        (record.castling >> (2 * color)) & 1,
+        (record.castling >> (2 * color + 1)) & 1);
+  }
+
+  EnpassantInitialization enp;
+  for (int color = 0; color < 4; color++) {
+    int to = record.enp_to[color];
+    if (to == kNumSquares) {
+      continue;
+    }
+    if (to > kNumSquares || !tables.legal.Test(to)) {
+      return false;
+    }
+    BoardLocation to_location = BoardLocation::FromSquare(to);
+    int from_row = to_location.GetRow() + kDoublePushBack[color][0];
+    int from_col = to_location.GetCol() + kDoublePushBack[color][1];
+    if (!IsLegalSquare(from_row, from_col)) {
+      return false;
+    }
+    enp.enp_moves[color] = Move(BoardLocation(from_row, from_col), to_location);
+  }
+
+  board.SetPosition(Player(static_cast<PlayerColor>(record.turn)), pieces,
+                    castling_rights, enp);
+  return true;
+}
+
+std::unique_ptr<PositionFileReader> PositionFileReader::Open(
+    const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0
+      || (size_t)st.st_size < sizeof(PositionFileHeader)) {
+    close(fd);
+    return nullptr;
+  }
+  size_t size = st.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping keeps the file open.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+
+  std::unique_ptr<PositionFileReader> reader(new PositionFileReader());
+  reader->data_ = data;
+  reader->data_size_ = size;
+
+  const auto* header = static_cast<const PositionFileHeader*>(data);
+  if (std::memcmp(header->magic, kPositionFileMagic,
+                  sizeof(kPositionFileMagic)) != 0
+      || header->version != kPositionFileVersion
+      || header->record_size != sizeof(PositionRecord)
+      || header->num_records
+           > (size - sizeof(PositionFileHeader)) / sizeof(PositionRecord)) {
+    return nullptr;
+  }
+  reader->records_ = reinterpret_cast<const PositionRecord*>(
+      static_cast<const char*>(data) + sizeof(PositionFileHeader));
+  reader->num_records_ = header->num_records;
+  return reader;
+}
+
+PositionFileReader::~PositionFileReader() {
+  if (data_ != nullptr) {
+    munmap(data_, data_size_);
+  }
+}
+
+std::unique_ptr<PositionFileWriter> PositionFileWriter::Create(
+    const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  std::unique_ptr<PositionFileWriter> writer(new PositionFileWriter());
+  writer->file_ = file;
+  // Written again with the final count on Close().
+  writer->ok_ = WriteHeader(file, 0);
+  return writer;
+}
+
+PositionFileWriter::~PositionFileWriter() {
+  Close();
+}
+
+bool PositionFileWriter::Write(const PositionRecord& record) {
+  if (file_ == nullptr) {
+    return false;
+  }
+  if (std::fwrite(&record, sizeof(record), 1, file_) != 1) {
+    ok_ = false;
+    return false;
+  }
+  num_records_++;
+  return true;
+}
+
+bool PositionFileWriter::Close() {
+  if (file_ == nullptr) {
+    return ok_;
+  }
+  ok_ = ok_
+    && std::fseek(file_, 0, SEEK_SET) == 0
+    && WriteHeader(file_, num_records_);
+  ok_ = std::fclose(file_) == 0 && ok_;
+  file_ = nullptr;
+  return ok_;
+}
+
+}  // namespace chess
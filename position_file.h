@@ -0,0 +1,117 @@
+#ifndef _POSITION_FILE_H_
+#define _POSITION_FILE_H_
+// Binary position corpora. Each position is a fixed-size PositionRecord, so
+// a file of them can be memory-mapped and indexed without any parsing.
+//
+// File layout: a PositionFileHeader followed by `num_records` records, in the
+// byte order of the machine that wrote them.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "board.h"
+
+namespace chess {
+
+constexpr char kPositionFileMagic[8] = {'4', 'P', 'C', 'P', 'O', 'S', 0, 0};
+constexpr uint32_t kPositionFileVersion = 1;
+// Pieces on the board at the start of a game.
+constexpr int kMaxRecordPieces = 64;
+
+struct PositionFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t num_records;
+};
+
+struct PositionRecord {
+  // Occupied squares (14 * row + col), as Bitboard lanes.
+  uint64_t occupied[4];
+  // color << 3 | piece type of the piece on each occupied square, in square
+  // order.
+  uint8_t pieces[kMaxRecordPieces];
+  uint8_t turn;
+  // Bit 2 * color is the kingside right, bit 2 * color + 1 the queenside.
+  uint8_t castling;
+  // Per color, the square a pawn just moved two squares to, if it may be
+  // captured en passant, or kNumSquares.
+  uint8_t enp_to[4];
+  // A GameResult; IN_PROGRESS if unknown.
+  int8_t result;
+  uint8_t has_score;
+  // Centipawns, from the RY team's point of view.
+  int16_t score;
+  uint8_t reserved[6];
+};
+
+static_assert(sizeof(PositionRecord) == 112);
+
+// Fills `record` from the board, including en-passant rights that come from
+// its move history. Returns false if the board has more than
+// kMaxRecordPieces pieces or the score does not fit in 16 bits.
+bool PackPosition(const Board& board, PositionRecord& record,
+                  std::optional<int> score = std::nullopt,
+                  GameResult result = IN_PROGRESS);
+
+// Sets up `board` in place from the record (see Board::SetPosition).
+// Returns false, leaving the board unchanged, if the record is malformed.
+bool UnpackPosition(const PositionRecord& record, Board& board);
+
+// Read-only view of a position file mapped into memory. Records are handed
+// out in place.
+class PositionFileReader {
+ public:
+  // Returns nullptr if the file cannot be mapped or is not a position file
+  // of this version.
+  static std::unique_ptr<PositionFileReader> Open(const std::string& path);
+  ~PositionFileReader();
+
+  PositionFileReader(const PositionFileReader&) = delete;
+  PositionFileReader& operator=(const PositionFileReader&) = delete;
+
+  size_t size() const { return num_records_; }
+  const PositionRecord& operator[](size_t i) const { return records_[i]; }
+  const PositionRecord* begin() const { return records_; }
+  const PositionRecord* end() const { return records_ + num_records_; }
+
+ private:
+  PositionFileReader() = default;
+
+  void* data_ = nullptr;
+  size_t data_size_ = 0;
+  const PositionRecord* records_ = nullptr;
+  size_t num_records_ = 0;
+};
+
+// Appends records to a new position file. The header's record count is
+// filled in by Close().
+class PositionFileWriter {
+ public:
+  // Returns nullptr if the file cannot be created.
+  static std::unique_ptr<PositionFileWriter> Create(const std::string& path);
+  ~PositionFileWriter();
+
+  PositionFileWriter(const PositionFileWriter&) = delete;
+  PositionFileWriter& operator=(const PositionFileWriter&) = delete;
+
+  bool Write(const PositionRecord& record);
+  // Returns false if any write failed.
+  bool Close();
+  uint64_t NumRecords() const { return num_records_; }
+
+ private:
+  PositionFileWriter() = default;
+
+  std::FILE* file_ = nullptr;
+  uint64_t num_records_ = 0;
+  bool ok_ = true;
+};
+
+}  // namespace chess
+
+#endif  // _POSITION_FILE_H_
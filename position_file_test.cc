@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+#include "board.h"
+#include "position_file.h"
+#include "utils.h"
+
+namespace chess {
+
+namespace {
+
+constexpr char kEnpassantFEN[] = "Y-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-{'enPassant':('','c4:d4','','')}-x,x,x,yR,yN,yB,yK,yQ,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,yP,yP,yP,yP,yP,x,x,x/x,x,x,8,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,10,gP,gB/bQ,bP,10,gP,gK/bK,bP,10,gP,gQ/bB,bP,10,gP,gB/bN,bP,10,gP,gN/bR,2,bP,8,gP,gR/x,x,x,4,rP,3,x,x,x/x,x,x,rP,rP,rP,rP,1,rP,rP,rP,x,x,x/x,x,x,rR,rN,rB,rQ,rK,rB,rN,rR,x,x,x";
+
+void ExpectSamePosition(Board& expected, Board& board) {
+  EXPECT_EQ(expected.GetTurn(), board.GetTurn());
+  EXPECT_EQ(expected.HashKey(), board.HashKey());
+  for (int color = 0; color < 4; color++) {
+    Player player(static_cast<PlayerColor>(color));
+    EXPECT_EQ(expected.GetCastlingRights(player),
+              board.GetCastlingRights(player));
+  }
+  Move expected_moves[300];
+  Move moves[300];
+  size_t num_expected = expected.GetLegalMoves(expected_moves, 300);
+  size_t num_moves = board.GetLegalMoves(moves, 300);
+  std::unordered_set<std::string> expected_strs;
+  std::unordered_set<std::string> strs;
+  for (size_t i = 0; i < num_expected; i++) {
+    expected_strs.insert(expected_moves[i].PrettyStr());
+  }
+  for (size_t i = 0; i < num_moves; i++) {
+    strs.insert(moves[i].PrettyStr());
+  }
+  EXPECT_EQ(expected_strs, strs);
+}
+
+}  // namespace
+
+TEST(PositionFileTest, PackAndUnpack) {
+  auto expected = ParseBoardFromFEN(kEnpassantFEN);
+  ASSERT_NE(nullptr, expected);
+
+  PositionRecord record;
+  ASSERT_TRUE(PackPosition(*expected, record, 35, WIN_RY));
+  EXPECT_EQ(YELLOW, record.turn);
+  EXPECT_EQ(BoardLocation(10, 3).GetSquare(), record.enp_to[BLUE]);
+  EXPECT_EQ(kNumSquares, record.enp_to[RED]);
+  EXPECT_TRUE(record.has_score);
+  EXPECT_EQ(35, record.score);
+  EXPECT_EQ(WIN_RY, record.result);
+
+  auto board = Board::CreateStandardSetup();
+  ASSERT_TRUE(UnpackPosition(record, *board));
+  ExpectSamePosition(*expected, *board);
+  // Red can take the blue pawn en passant.
+  EXPECT_EQ(record.enp_to[BLUE],
+            board->GetEnpassantInitialization().enp_moves[BLUE]->To()
+              .GetSquare());
+}
+
+TEST(PositionFileTest, PackAfterMoves) {
+  // En-passant rights come from the move history.
+  auto expected = Board::CreateStandardSetup();
+  expected->MakeMove(Move(BoardLocation(12, 7), BoardLocation(10, 7)));
+  expected->MakeMove(Move(BoardLocation(7, 1), BoardLocation(7, 3)));
+
+  PositionRecord record;
+  ASSERT_TRUE(PackPosition(*expected, record));
+  EXPECT_FALSE(record.has_score);
+  EXPECT_EQ(IN_PROGRESS, record.result);
+  EXPECT_EQ(BoardLocation(10, 7).GetSquare(), record.enp_to[RED]);
+  EXPECT_EQ(BoardLocation(7, 3).GetSquare(), record.enp_to[BLUE]);
+
+  auto board = Board::CreateStandardSetup();
+  ASSERT_TRUE(UnpackPosition(record, *board));
+  ExpectSamePosition(*expected, *board);
+}
+
+TEST(PositionFileTest, RejectsMalformedRecords) {
+  auto board = Board::CreateStandardSetup();
+  PositionRecord record;
+  ASSERT_TRUE(PackPosition(*board, record));
+  int64_t hash_key = board->HashKey();
+
+  PositionRecord bad = record;
+  bad.turn = 4;
+  EXPECT_FALSE(UnpackPosition(bad, *board));
+
+  bad = record;
+  bad.pieces[0] = 4 << 3 | PAWN;
+  EXPECT_FALSE(UnpackPosition(bad, *board));
+
+  // A cut-off corner square.
+  bad = record;
+  bad.occupied[0] |= 1;
+  EXPECT_FALSE(UnpackPosition(bad, *board));
+
+  // More pieces of one color than a piece list holds.
+  bad = record;
+  for (int i = 0; i < kMaxRecordPieces; i++) {
+    bad.pieces[i] = RED << 3 | PAWN;
+  }
+  EXPECT_FALSE(UnpackPosition(bad, *board));
+
+  EXPECT_EQ(hash_key, board->HashKey());
+}
+
+TEST(PositionFileTest, RejectsOutOfRangeScores) {
+  auto board = Board::CreateStandardSetup();
+  PositionRecord record;
+  EXPECT_TRUE(PackPosition(*board, record, -32768));
+  EXPECT_EQ(-32768, record.score);
+  EXPECT_FALSE(PackPosition(*board, record, 32768));
+  EXPECT_FALSE(PackPosition(*board, record, -1000000));
+}
+
+TEST(PositionFileTest, WriteAndRead) {
+  std::string path = testing::TempDir() + "/position_file_test.pos";
+  auto writer = PositionFileWriter::Create(path);
+  ASSERT_NE(nullptr, writer);
+
+  auto start = Board::CreateStandardSetup();
+  auto enpassant = ParseBoardFromFEN(kEnpassantFEN);
+  PositionRecord record;
+  ASSERT_TRUE(PackPosition(*start, record));
+  ASSERT_TRUE(writer->Write(record));
+  ASSERT_TRUE(PackPosition(*enpassant, record, -20));
+  ASSERT_TRUE(writer->Write(record));
+  ASSERT_TRUE(writer->Close());
+
+  auto reader = PositionFileReader::Open(path);
+  ASSERT_NE(nullptr, reader);
+  ASSERT_EQ(2, reader->size());
+  EXPECT_EQ(-20, (*reader)[1].score);
+
+  auto board = Board::CreateStandardSetup();
+  ASSERT_TRUE(UnpackPosition((*reader)[0], *board));
+  ExpectSamePosition(*start, *board);
+  ASSERT_TRUE(UnpackPosition((*reader)[1], *board));
+  ExpectSamePosition(*enpassant, *board);
+
+  EXPECT_EQ(nullptr, PositionFileReader::Open(path + ".missing"));
+}
+
+}  // namespace chess
@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <chrono>
+#include <fstream>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <gtest/gtest.h>
@@ -8,6 +11,7 @@
 #include "board.h"
 #include "player.h"
 #include "transposition_table.h"
+#include "utils.h"
 
 namespace chess {
 namespace {
@@ -31,6 +35,108 @@ TEST(Speed, ThreadTest) {
   std::cout << "Duration (ms): " << duration.count() << std::endl;
 }
 
+namespace {
+
+// Counts legal leaf nodes, exercising move generation and attack detection.
+int64_t CountLeafNodes(Board& board, int depth) {
+  Move moves[300];
+  size_t num_moves = board.GetPseudoLegalMoves2(moves, 300);
+  Player turn = board.GetTurn();
+  int64_t nodes = 0;
+  for (size_t i = 0; i < num_moves; i++) {
+    board.MakeMove(moves[i]);
+    if (!board.IsKingInCheck(turn)) {
+      nodes += depth <= 1 ? 1 : CountLeafNodes(board, depth - 1);
+    }
+    board.UndoMove();
+  }
+  return nodes;
+}
+
+}  // namespace
+
+TEST(Speed, MoveGenLayoutTest) {
+  for (MoveGenLayout layout : {LAYOUT_BITBOARD, LAYOUT_PADDED_MAILBOX}) {
+    auto board = Board::CreateStandardSetup();
+    board->SetMoveGenLayout(layout);
+
+    auto start = std::chrono::system_clock::now();
+    int64_t nodes = 0;
+    for (int i = 0; i < 20; i++) {
+      nodes += CountLeafNodes(*board, 4);
+    }
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now() - start);
+
+    std::cout << (layout == LAYOUT_BITBOARD ? "Bitboard" : "Padded mailbox")
+      << " layout" << std::endl;
+    std::cout << "Duration (ms): " << duration.count() << std::endl;
+    int nps = (int) ((((float)nodes) / std::max<int64_t>(1, duration.count()))*1000.0);
+    std::cout << "Nodes/sec: " << nps << std::endl;
+  }
+}
+
+TEST(Speed, ParseFENTest) {
+  std::ifstream infile("FENs_4PC_balanced.txt");
+  std::vector<std::string> fens;
+  std::string line;
+  while (std::getline(infile, line)) {
+    if (line.size() >= 10) {
+      fens.push_back(line);
+    }
+  }
+  if (fens.empty()) {
+    GTEST_SKIP() << "FENs_4PC_balanced.txt not found";
+  }
+
+  auto board = Board::CreateStandardSetup();
+  for (bool in_place : {false, true}) {
+    auto start = std::chrono::system_clock::now();
+    int64_t checksum = 0;
+    for (const auto& fen : fens) {
+      if (in_place) {
+        ASSERT_TRUE(ParseFEN(fen, *board));
+        checksum ^= board->HashKey();
+      } else {
+        auto parsed = ParseBoardFromFEN(fen);
+        ASSERT_NE(nullptr, parsed);
+        checksum ^= parsed->HashKey();
+      }
+    }
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now() - start);
+
+    std::cout << (in_place ? "ParseFEN" : "ParseBoardFromFEN") << std::endl;
+    std::cout << "Duration (us): " << duration.count() << std::endl;
+    std::cout << "FENs/sec: "
+      << (int64_t) (fens.size() * 1e6 / std::max<int64_t>(1, duration.count()))
+      << std::endl;
+    std::cout << "Checksum: " << checksum << std::endl;
+  }
+}
+
+TEST(Speed, AttackMapsTest) {
+  for (bool enable_attack_maps : {false, true}) {
+    auto board = Board::CreateStandardSetup();
+    PlayerOptions options;
+    options.enable_multithreading = false;
+    options.enable_attack_maps = enable_attack_maps;
+    AlphaBetaPlayer player(options);
+
+    auto start = std::chrono::system_clock::now();
+    player.MakeMove(*board, std::nullopt, 12);
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now() - start);
+
+    std::cout << "Attack maps " << (enable_attack_maps ? "on" : "off")
+      << std::endl;
+    std::cout << "Duration (ms): " << duration.count() << std::endl;
+    int nps = (int) ((((float)player.GetNumEvaluations()) / duration.count())*1000.0);
+    std::cout << "Nodes/sec: " << nps << std::endl;
+    std::cout << "Nodes: " << player.GetNumEvaluations() << std::endl;
+  }
+}
+
 TEST(Speed, MoveTest) {
   auto start = std::chrono::system_clock::now();
   auto board = Board::CreateStandardSetup();
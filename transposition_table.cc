@@ -1,46 +1,365 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <optional>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include "transposition_table.h"
 
 namespace chess {
 
+namespace {
+
+// Depths are stored as depth - kDepthOffset, so that 0 marks an empty slot.
+constexpr int kDepthOffset = -1;
+constexpr int kMinDepth = kDepthOffset + 1;
+constexpr int kMaxDepth = kDepthOffset + 255;
+constexpr int kScoreBits = 28;
+constexpr int kMaxScore = (1 << (kScoreBits - 1)) - 1;
+
+constexpr int kDepthShift = PackedMove::kCompactBits;
+constexpr int kBoundShift = kDepthShift + 8;
+constexpr int kPvShift = kBoundShift + 2;
+constexpr int kGenerationShift = kPvShift + 1;
+constexpr int kScoreShift = kGenerationShift + 6;
+static_assert(kScoreShift + kScoreBits == 64);
+
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+constexpr char kFileMagic[8] = {'4', 'P', 'C', 'T', 'T', 0, 0, 0};
+constexpr uint32_t kFileVersion = 1;
+
+// Header of a file written by TranspositionTable::SaveToFile. The clusters
+// follow it in the byte order of the machine that wrote them.
+struct TranspositionTableFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t cluster_size;
+  uint64_t num_clusters;
+  // Hash keys, and so the table contents, are only meaningful with the same
+  // Zobrist keys.
+  uint64_t zobrist_fingerprint;
+  uint32_t generation;
+  uint32_t reserved;
+};
+
+uint64_t ZobristFingerprint() {
+  // FNV-1a over the keys.
+  uint64_t fingerprint = 0xcbf29ce484222325;
+  auto add = [&fingerprint](const int64_t* keys, size_t size) {
+    for (size_t i = 0; i < size / sizeof(int64_t); i++) {
+      fingerprint = (fingerprint ^ uint64_t(keys[i])) * 0x100000001b3;
+    }
+  };
+  add(&kZobristKeys.piece[0][0][0][0], sizeof(kZobristKeys.piece));
+  add(kZobristKeys.turn, sizeof(kZobristKeys.turn));
+  return fingerprint;
+}
+
+static_assert(std::atomic_ref<uint32_t>::is_always_lock_free);
+
+uint32_t LoadWord(uint32_t& word) {
+  return std::atomic_ref<uint32_t>(word).load(std::memory_order_relaxed);
+}
+
+void StoreWord(uint32_t& word, uint32_t value) {
+  std::atomic_ref<uint32_t>(word).store(value, std::memory_order_relaxed);
+}
+
+// A consistent snapshot of an entry, with the key decoded.
+struct EntrySnapshot {
+  uint32_t key;
+  uint64_t data;
+};
+
+EntrySnapshot Load(PackedHashTableEntry& entry) {
+  uint32_t key = LoadWord(entry.key);
+  uint32_t data0 = LoadWord(entry.data[0]);
+  uint32_t data1 = LoadWord(entry.data[1]);
+  return {key ^ data0 ^ data1, data0 | (uint64_t(data1) << 32)};
+}
+
+void Store(PackedHashTableEntry& entry, uint32_t key, uint64_t data) {
+  uint32_t data0 = uint32_t(data);
+  uint32_t data1 = uint32_t(data >> 32);
+  StoreWord(entry.data[0], data0);
+  StoreWord(entry.data[1], data1);
+  StoreWord(entry.key, key ^ data0 ^ data1);
+}
+
+int GetDepth8(uint64_t data) {
+  return (data >> kDepthShift) & 0xFF;
+}
+
+int GetGeneration(uint64_t data) {
+  return (data >> kGenerationShift) & 0x3F;
+}
+
+}  // namespace
+
 TranspositionTable::TranspositionTable(size_t table_size) {
   assert((table_size > 0) && "transposition table_size = 0");
-  table_size_ = table_size;
-  hash_table_ = (HashTableEntry*) calloc(table_size, sizeof(HashTableEntry));
-  assert(
-      (hash_table_ != nullptr) && 
-      "Can't create transposition table. Try using a smaller size.");
+  Allocate((table_size + kClusterSize - 1) / kClusterSize);
+}
+
+TranspositionTable::~TranspositionTable() {
+  Free();
+}
+
+void TranspositionTable::Allocate(size_t num_clusters) {
+  size_t bytes = num_clusters * sizeof(HashTableCluster);
+  // Whole huge pages, so that the last one can be a huge page too.
+  size_t huge_bytes = (bytes + kHugePageSize - 1) / kHugePageSize
+    * kHugePageSize;
+  void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (bytes >= kHugePageSize) {
+    memory = mmap(nullptr, huge_bytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+#endif
+  if (memory == MAP_FAILED) {
+    memory = mmap(nullptr, huge_bytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      std::cout << "Can't create transposition table. Try using a smaller "
+        << "size." << std::endl;
+      abort();
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(memory, huge_bytes, MADV_HUGEPAGE);
+#endif
+  }
+  // Fresh anonymous pages read as zero, which is an empty entry, and are
+  // only faulted in when first written.
+  hash_table_ = static_cast<HashTableCluster*>(memory);
+  num_clusters_ = num_clusters;
+  mapped_bytes_ = huge_bytes;
+  generation_ = 0;
+}
+
+void TranspositionTable::Free() {
+  if (hash_table_ != nullptr) {
+    munmap(hash_table_, mapped_bytes_);
+    hash_table_ = nullptr;
+    num_clusters_ = 0;
+    mapped_bytes_ = 0;
+  }
+}
+
+void TranspositionTable::Clear(int num_threads) {
+  auto clear = [this](size_t begin, size_t end) {
+    std::memset(static_cast<void*>(hash_table_ + begin), 0,
+                (end - begin) * sizeof(HashTableCluster));
+  };
+  num_threads = std::max(num_threads, 1);
+  size_t clusters_per_thread = (num_clusters_ + num_threads - 1) / num_threads;
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; i++) {
+    size_t begin = std::min(num_clusters_, i * clusters_per_thread);
+    size_t end = std::min(num_clusters_, begin + clusters_per_thread);
+    threads.emplace_back(clear, begin, end);
+  }
+  clear(0, std::min(num_clusters_, clusters_per_thread));
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  generation_ = 0;
+}
+
+void TranspositionTable::Resize(size_t table_size, int num_threads) {
+  assert((table_size > 0) && "transposition table_size = 0");
+  size_t num_clusters = (table_size + kClusterSize - 1) / kClusterSize;
+  if (num_clusters == num_clusters_) {
+    Clear(num_threads);
+    return;
+  }
+  Free();
+  Allocate(num_clusters);
+}
+
+TranspositionTableStats& TranspositionTableStats::operator+=(
+    const TranspositionTableStats& other) {
+  probes += other.probes;
+  hits += other.hits;
+  collisions += other.collisions;
+  cutoffs += other.cutoffs;
+  stores += other.stores;
+  for (int bound = 0; bound < 3; bound++) {
+    replaced[bound] += other.replaced[bound];
+  }
+  replaced_old += other.replaced_old;
+  return *this;
 }
 
-const HashTableEntry* TranspositionTable::Get(int64_t key) {
-  size_t n = key % table_size_;
-  HashTableEntry* entry = hash_table_ + n;
-  if (entry->key == key) {
-    return entry;
+std::optional<HashTableEntry> TranspositionTable::Get(
+    int64_t key, TranspositionTableStats* stats) const {
+  if (stats != nullptr) {
+    stats->probes++;
   }
-  return nullptr;
+  HashTableCluster* cluster = GetCluster(key);
+  uint32_t key32 = uint32_t(key);
+  for (auto& entry : cluster->entries) {
+    auto [entry_key, data] = Load(entry);
+    int depth8 = GetDepth8(data);
+    if (entry_key == key32 && depth8 != 0) {
+      if (stats != nullptr) {
+        stats->hits++;
+      }
+      HashTableEntry result;
+      result.depth = depth8 + kDepthOffset;
+      result.move = PackedMove::FromCompact(
+          data & ((1 << PackedMove::kCompactBits) - 1));
+      result.score = int64_t(data) >> kScoreShift;
+      result.bound = static_cast<ScoreBound>((data >> kBoundShift) & 0x3);
+      result.is_pv = (data >> kPvShift) & 1;
+      return result;
+    }
+  }
+  return std::nullopt;
 }
 
 void TranspositionTable::Save(
     int64_t key, int depth, std::optional<Move> move, int score,
-    ScoreBound bound, bool is_pv) {
-  size_t n = key % table_size_;
-  HashTableEntry& entry = hash_table_[n];
-  if (bound == EXACT
-      || entry.key != key
-      || entry.depth < depth) {
-    entry.key = key;
-    entry.depth = depth;
-    entry.move = move;
-    entry.score = score;
-    entry.bound = bound;
-    entry.is_pv = is_pv;
+    ScoreBound bound, bool is_pv, TranspositionTableStats* stats) {
+  HashTableCluster* cluster = GetCluster(key);
+  uint32_t key32 = uint32_t(key);
+
+  // Take the slot of the same position or an empty one if there is one, and
+  // otherwise the one of least value: shallow entries from old searches go
+  // first.
+  auto value = [this](uint64_t data) {
+    int age = (kNumGenerations + generation_ - GetGeneration(data))
+      % kNumGenerations;
+    return GetDepth8(data) - 8 * age;
+  };
+  PackedHashTableEntry* replace = nullptr;
+  EntrySnapshot old = {};
+  for (auto& entry : cluster->entries) {
+    EntrySnapshot snapshot = Load(entry);
+    if (replace == nullptr
+        || GetDepth8(snapshot.data) == 0
+        || snapshot.key == key32
+        || value(snapshot.data) < value(old.data)) {
+      replace = &entry;
+      old = snapshot;
+      if (GetDepth8(snapshot.data) == 0 || snapshot.key == key32) {
+        break;
+      }
+    }
+  }
+
+  uint32_t compact_move = move.has_value() ? PackedMove(*move).Compact() : 0;
+  uint64_t old_data = old.data;
+  if (old.key == key32 && GetDepth8(old_data) != 0) {
+    // Keep a deeper result for the same position from this search, unless
+    // the new one is exact.
+    if (bound != EXACT
+        && depth <= GetDepth8(old_data) + kDepthOffset
+        && GetGeneration(old_data) == generation_) {
+      return;
+    }
+    if (compact_move == 0) {
+      compact_move = old_data & ((1 << PackedMove::kCompactBits) - 1);
+    }
+  } else if (stats != nullptr && GetDepth8(old_data) != 0) {
+    stats->replaced[(old_data >> kBoundShift) & 0x3]++;
+    if (GetGeneration(old_data) != generation_) {
+      stats->replaced_old++;
+    }
   }
+  if (stats != nullptr) {
+    stats->stores++;
+  }
+
+  depth = std::clamp(depth, kMinDepth, kMaxDepth);
+  score = std::clamp(score, -kMaxScore, kMaxScore);
+  uint64_t data = compact_move
+    | (uint64_t(depth - kDepthOffset) << kDepthShift)
+    | (uint64_t(bound) << kBoundShift)
+    | (uint64_t(is_pv) << kPvShift)
+    | (uint64_t(generation_) << kGenerationShift)
+    | (uint64_t(int64_t(score)) << kScoreShift);
+  Store(*replace, key32, data);
 }
 
 
-}  // namespace chess
+int TranspositionTable::HashFull() const {
+  constexpr size_t kSampleClusters = 1000 / kClusterSize;
+  size_t num_clusters = std::min(num_clusters_, kSampleClusters);
+  int num_entries = 0;
+  for (size_t i = 0; i < num_clusters; i++) {
+    for (auto& entry : hash_table_[i].entries) {
+      auto [entry_key, data] = Load(entry);
+      if (GetDepth8(data) != 0 && GetGeneration(data) == generation_) {
+        num_entries++;
+      }
+    }
+  }
+  return num_entries * 1000 / (num_clusters * kClusterSize);
+}
+
+bool TranspositionTable::SaveToFile(const std::string& path) const {
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  TranspositionTableFileHeader header = {};
+  std::memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+  header.version = kFileVersion;
+  header.cluster_size = sizeof(HashTableCluster);
+  header.num_clusters = num_clusters_;
+  header.zobrist_fingerprint = ZobristFingerprint();
+  header.generation = generation_;
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+    && std::fwrite(hash_table_, sizeof(HashTableCluster), num_clusters_, file)
+         == num_clusters_;
+  return std::fclose(file) == 0 && ok;
+}
 
+bool TranspositionTable::LoadFromFile(const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  TranspositionTableFileHeader header;
+  struct stat st;
+  bool valid = std::fread(&header, sizeof(header), 1, file) == 1
+    && fstat(fileno(file), &st) == 0
+    && std::memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) == 0
+    && header.version == kFileVersion
+    && header.cluster_size == sizeof(HashTableCluster)
+    && header.num_clusters > 0
+    && (size_t)st.st_size - sizeof(header)
+         == header.num_clusters * sizeof(HashTableCluster)
+    && header.zobrist_fingerprint == ZobristFingerprint()
+    && header.generation < kNumGenerations;
+  if (!valid) {
+    std::fclose(file);
+    return false;
+  }
+
+  if (header.num_clusters != num_clusters_) {
+    Free();
+    Allocate(header.num_clusters);
+  }
+  bool ok = std::fread(hash_table_, sizeof(HashTableCluster), num_clusters_,
+                       file) == num_clusters_;
+  std::fclose(file);
+  if (!ok) {
+    Clear();
+    return false;
+  }
+  generation_ = header.generation;
+  return true;
+}
+
+}  // namespace chess
@@ -4,6 +4,7 @@
 #include <atomic>
 #include <cstdint>
 #include <optional>
+#include <string>
 
 #include "board.h"
 
@@ -13,32 +14,126 @@ enum ScoreBound {
   EXACT = 0, LOWER_BOUND = 1, UPPER_BOUND = 2,
 };
 
+// A position's entry as returned by TranspositionTable::Get.
 struct HashTableEntry {
-  int64_t key;
   int depth;
-  std::optional<Move> move;
+  PackedMove move;
   int score;
   ScoreBound bound;
   bool is_pv;
 };
 
+// Counts of table activity. Each search thread keeps its own, so that
+// counting does not add shared writes to every probe; the player sums them
+// after a search.
+struct TranspositionTableStats {
+  int64_t probes = 0;
+  int64_t hits = 0;
+  // Hits on an entry of another position with the same stored key, found
+  // because the entry's move is not a move in the probed position.
+  int64_t collisions = 0;
+  // Hits whose bound and depth ended the search of the node.
+  int64_t cutoffs = 0;
+  int64_t stores = 0;
+  // Stores that evicted another position's entry, by the evicted entry's
+  // bound, and how many of those were written by an earlier search.
+  int64_t replaced[3] = {0, 0, 0};
+  int64_t replaced_old = 0;
+
+  int64_t Misses() const { return probes - hits; }
+  TranspositionTableStats& operator+=(const TranspositionTableStats& other);
+};
+
+// Compact form of an entry in the table, 12 bytes. `key` holds the low 32
+// bits of the hash key xor both words of `data`; the high bits of the hash
+// key choose the cluster. Search threads share the table without locks and
+// access each word atomically, so a reader can see words from two different
+// writes; the key check then fails and the entry is treated as missing.
+// `data` packs the rest of the entry:
+//   bits  0-18  the move (PackedMove::Compact)
+//   bits 19-26  depth - kDepthOffset, 0 if the slot is empty
+//   bits 27-28  the bound
+//   bit  29     is_pv
+//   bits 30-35  the generation of the search that wrote it
+//   bits 36-63  the score, signed
+struct PackedHashTableEntry {
+  uint32_t key;
+  uint32_t data[2];
+};
+
+constexpr int kClusterSize = 5;
+
+// Entries that share a cache line. Positions that map to the cluster may be
+// stored in any of its slots.
+struct alignas(64) HashTableCluster {
+  PackedHashTableEntry entries[kClusterSize];
+};
+
+static_assert(sizeof(PackedHashTableEntry) == 12);
+static_assert(sizeof(HashTableCluster) == 64);
+
+// The table memory is mapped with mmap, on huge pages where the system
+// provides them: explicit ones first, otherwise transparent ones. Probes
+// touch random cache lines across the whole table, so large tables spend
+// much of their probe time in TLB misses on 4KB pages.
 class TranspositionTable {
  public:
-   TranspositionTable(size_t table_size);
+  // Room for at least `table_size` entries, rounded up to whole clusters.
+  TranspositionTable(size_t table_size);
+  TranspositionTable(const TranspositionTable&) = delete;
+  TranspositionTable& operator=(const TranspositionTable&) = delete;
+  ~TranspositionTable();
 
-   const HashTableEntry* Get(int64_t key);
-   void Save(int64_t key, int depth, std::optional<Move> move,
-             int score, ScoreBound bound, bool is_pv);
+  // `stats`, if given, counts the probe or the store.
+  std::optional<HashTableEntry> Get(
+      int64_t key, TranspositionTableStats* stats = nullptr) const;
+  void Save(int64_t key, int depth, std::optional<Move> move,
+            int score, ScoreBound bound, bool is_pv,
+            TranspositionTableStats* stats = nullptr);
+  // Starts a new search. Entries written by earlier searches are replaced
+  // first.
+  void NewSearch() { generation_ = (generation_ + 1) % kNumGenerations; }
 
-  ~TranspositionTable() {
-    if (hash_table_ != nullptr) {
-      free(hash_table_);
-    }
-  }
+  // Empties the table, splitting the work between `num_threads` threads.
+  // Must not be called during a search.
+  void Clear(int num_threads = 1);
+  // Changes the capacity to at least `table_size` entries, dropping all
+  // entries. The memory is kept if the number of clusters does not change.
+  // Must not be called during a search.
+  void Resize(size_t table_size, int num_threads = 1);
+
+  // Writes an image of the table to `path`: a small header with the format
+  // version, the size and a fingerprint of the Zobrist keys, followed by the
+  // clusters as they are in memory. Returns false on I/O errors.
+  bool SaveToFile(const std::string& path) const;
+  // Replaces the table with one written by SaveToFile, taking its size.
+  // Returns false and leaves the table unchanged if the file is missing or
+  // was written by an incompatible build; on a read error after that the
+  // table is left empty. Must not be called during a search.
+  bool LoadFromFile(const std::string& path);
+
+  size_t NumClusters() const { return num_clusters_; }
+  // Permille of entries written by the current search, estimated from the
+  // first 1000 entries (UCI hashfull).
+  int HashFull() const;
 
  private:
-  HashTableEntry* hash_table_ = nullptr;
-  size_t table_size_ = 0;
+  static constexpr int kNumGenerations = 64;
+
+  void Allocate(size_t num_clusters);
+  void Free();
+
+  HashTableCluster* GetCluster(int64_t key) const {
+    // The high half of key * num_clusters_, which spreads the keys evenly
+    // without a division.
+    return hash_table_
+      + (((unsigned __int128)(uint64_t)key * num_clusters_) >> 64);
+  }
+
+  HashTableCluster* hash_table_ = nullptr;
+  size_t num_clusters_ = 0;
+  size_t mapped_bytes_ = 0;
+  int generation_ = 0;
 };
 
 
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "transposition_table.h"
+
+namespace chess {
+
+namespace {
+
+const Move kMove(BoardLocation(12, 7), BoardLocation(10, 7));
+const Move kPromotion(BoardLocation(4, 3), BoardLocation(3, 3),
+                      Piece::kNoPiece, BoardLocation::kNoLocation,
+                      Piece::kNoPiece, QUEEN);
+
+}  // namespace
+
+TEST(TranspositionTableTest, SaveAndGet) {
+  TranspositionTable table(1000);
+  EXPECT_FALSE(table.Get(1234).has_value());
+
+  table.Save(1234, 7, kMove, -350, LOWER_BOUND, true);
+  auto entry = table.Get(1234);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(7, entry->depth);
+  EXPECT_EQ(PackedMove(kMove), entry->move);
+  EXPECT_EQ(-350, entry->score);
+  EXPECT_EQ(LOWER_BOUND, entry->bound);
+  EXPECT_TRUE(entry->is_pv);
+
+  table.Save(-98765, 0, kPromotion, 100'000'000, EXACT, false);
+  entry = table.Get(-98765);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(0, entry->depth);
+  EXPECT_EQ(PackedMove(kPromotion), entry->move);
+  EXPECT_EQ(100'000'000, entry->score);
+  EXPECT_EQ(EXACT, entry->bound);
+  EXPECT_FALSE(entry->is_pv);
+
+  table.Save(555, 3, std::nullopt, -100'000'000, UPPER_BOUND, false);
+  entry = table.Get(555);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_FALSE(entry->move.Present());
+  EXPECT_EQ(-100'000'000, entry->score);
+}
+
+TEST(TranspositionTableTest, KeepsDeeperEntry) {
+  TranspositionTable table(1000);
+  table.Save(42, 8, kMove, 10, LOWER_BOUND, false);
+
+  // Shallower non-exact results do not replace it.
+  table.Save(42, 5, std::nullopt, 20, UPPER_BOUND, false);
+  EXPECT_EQ(8, table.Get(42)->depth);
+
+  // Exact ones do, and the move is kept if the new result has none.
+  table.Save(42, 5, std::nullopt, 30, EXACT, false);
+  auto entry = table.Get(42);
+  EXPECT_EQ(5, entry->depth);
+  EXPECT_EQ(30, entry->score);
+  EXPECT_EQ(PackedMove(kMove), entry->move);
+
+  // So do results of a later search.
+  table.NewSearch();
+  table.Save(42, 1, std::nullopt, 40, UPPER_BOUND, false);
+  EXPECT_EQ(1, table.Get(42)->depth);
+}
+
+TEST(TranspositionTableTest, ReplacesShallowAndOldEntries) {
+  // A single cluster, which every key maps to.
+  TranspositionTable table(kClusterSize);
+  ASSERT_EQ(1, table.NumClusters());
+  for (int i = 0; i < kClusterSize; i++) {
+    table.Save(i + 1, 10 + i, std::nullopt, i, EXACT, false);
+  }
+  for (int i = 0; i < kClusterSize; i++) {
+    EXPECT_TRUE(table.Get(i + 1).has_value());
+  }
+
+  // The shallowest entry makes room.
+  table.Save(100, 3, std::nullopt, 0, EXACT, false);
+  EXPECT_FALSE(table.Get(1).has_value());
+  EXPECT_TRUE(table.Get(100).has_value());
+
+  // Two searches later, deep entries from the first search are worth less
+  // than a shallow entry from this one.
+  table.NewSearch();
+  table.NewSearch();
+  table.Save(101, 3, std::nullopt, 0, EXACT, false);
+  EXPECT_FALSE(table.Get(100).has_value());
+  table.Save(102, 3, std::nullopt, 0, EXACT, false);
+  EXPECT_TRUE(table.Get(101).has_value());
+  EXPECT_TRUE(table.Get(102).has_value());
+  EXPECT_FALSE(table.Get(2).has_value());
+}
+
+TEST(TranspositionTableTest, StatsAndHashFull) {
+  // A single cluster, which every key maps to.
+  TranspositionTable table(kClusterSize);
+  TranspositionTableStats stats;
+  EXPECT_EQ(0, table.HashFull());
+  for (int i = 0; i < kClusterSize; i++) {
+    table.Save(i + 1, 10 + i, std::nullopt, 0, i == 0 ? LOWER_BOUND : EXACT,
+               false, &stats);
+  }
+  EXPECT_EQ(1000, table.HashFull());
+  EXPECT_TRUE(table.Get(1, &stats).has_value());
+  EXPECT_FALSE(table.Get(100, &stats).has_value());
+  EXPECT_EQ(2, stats.probes);
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(1, stats.Misses());
+  EXPECT_EQ(kClusterSize, stats.stores);
+
+  // Entries of the previous search no longer count as used, and evicting
+  // one counts as an old replacement.
+  table.NewSearch();
+  EXPECT_EQ(0, table.HashFull());
+  table.Save(100, 3, std::nullopt, 0, EXACT, false, &stats);
+  EXPECT_EQ(200, table.HashFull());
+  EXPECT_EQ(1, stats.replaced[LOWER_BOUND]);
+  EXPECT_EQ(0, stats.replaced[EXACT]);
+  EXPECT_EQ(1, stats.replaced_old);
+
+  TranspositionTableStats total;
+  total += stats;
+  total += stats;
+  EXPECT_EQ(4, total.probes);
+  EXPECT_EQ(2, total.replaced[LOWER_BOUND]);
+}
+
+TEST(TranspositionTableTest, ClearAndResize) {
+  TranspositionTable table(1000);
+  size_t num_clusters = table.NumClusters();
+  for (int64_t key = 1; key <= 100; key++) {
+    table.Save(key * 0x1234'5678'9abcLL, 5, kMove, 10, EXACT, false);
+  }
+  table.Clear(3);
+  for (int64_t key = 1; key <= 100; key++) {
+    EXPECT_FALSE(table.Get(key * 0x1234'5678'9abcLL).has_value());
+  }
+
+  table.Save(7, 5, kMove, 10, EXACT, false);
+  table.Resize(1000, 2);
+  EXPECT_EQ(num_clusters, table.NumClusters());
+  EXPECT_FALSE(table.Get(7).has_value());
+
+  table.Resize(100'000);
+  EXPECT_EQ(100'000 / kClusterSize, table.NumClusters());
+  table.Save(7, 5, kMove, 10, EXACT, false);
+  EXPECT_EQ(5, table.Get(7)->depth);
+}
+
+TEST(TranspositionTableTest, SaveAndLoadFile) {
+  std::string path = testing::TempDir() + "/transposition_table_test.tt";
+  TranspositionTable table(1000);
+  table.NewSearch();
+  table.Save(1234, 7, kMove, -350, LOWER_BOUND, true);
+  ASSERT_TRUE(table.SaveToFile(path));
+
+  // The loaded table takes the saved size, contents and generation.
+  TranspositionTable loaded(100'000);
+  ASSERT_TRUE(loaded.LoadFromFile(path));
+  EXPECT_EQ(table.NumClusters(), loaded.NumClusters());
+  auto entry = loaded.Get(1234);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(7, entry->depth);
+  EXPECT_EQ(PackedMove(kMove), entry->move);
+  EXPECT_EQ(-350, entry->score);
+  loaded.Save(1234, 3, std::nullopt, 0, UPPER_BOUND, false);
+  EXPECT_EQ(7, loaded.Get(1234)->depth);
+
+  EXPECT_FALSE(loaded.LoadFromFile(path + ".missing"));
+  // A truncated file is rejected and leaves the table alone.
+  std::FILE* file = std::fopen(path.c_str(), "r+b");
+  ASSERT_NE(nullptr, file);
+  ASSERT_EQ(0, ftruncate(fileno(file), 100));
+  std::fclose(file);
+  EXPECT_FALSE(loaded.LoadFromFile(path));
+  EXPECT_TRUE(loaded.Get(1234).has_value());
+}
+
+TEST(TranspositionTableTest, ConcurrentAccessKeepsEntriesConsistent) {
+  // Threads that share a single cluster overwrite each other's entries, and
+  // a lookup sees either an entry as some thread wrote it or nothing.
+  TranspositionTable table(kClusterSize);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&table, t]() {
+      for (int i = 0; i < 200'000; i++) {
+        int64_t key = ((i * 7 + t) % 64 + 1) * 0x1'0000'0001LL;
+        table.Save(key, key % 50, std::nullopt, key % 100'000, EXACT, false);
+        int64_t other_key = ((i * 13 + t) % 64 + 1) * 0x1'0000'0001LL;
+        auto entry = table.Get(other_key);
+        if (entry.has_value()) {
+          ASSERT_EQ(other_key % 50, entry->depth);
+          ASSERT_EQ(other_key % 100'000, entry->score);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace chess
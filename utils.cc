@@ -1,13 +1,16 @@
 #include "utils.h"
 
 #include <tuple>
+#include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <iostream>
 #include <exception>
 #include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "board.h"
@@ -71,14 +74,48 @@ std::optional<std::vector<bool>> ParseCastlingAvailability(
   return availability;
 }
 
-std::optional<BoardLocation> ParseEnpLocation(const std::string& enp) {
+namespace {
+
+// Returns the part of `s` before the first `delimiter` and removes it, with
+// the delimiter, from `s`. Without a delimiter all of `s` is returned.
+std::string_view NextToken(std::string_view& s, char delimiter) {
+  size_t pos = s.find(delimiter);
+  std::string_view token = s.substr(0, pos);
+  s = pos == std::string_view::npos
+    ? std::string_view() : s.substr(pos + 1);
+  return token;
+}
+
+size_t CountChar(std::string_view s, char ch) {
+  return std::count(s.begin(), s.end(), ch);
+}
+
+// Four comma-separated 0/1 flags, indexed by PlayerColor.
+bool ParseCastlingFlags(std::string_view field, bool (&flags)[4]) {
+  if (CountChar(field, ',') != 3) {
+    return false;
+  }
+  for (int i = 0; i < 4; i++) {
+    std::string_view part = NextToken(field, ',');
+    if (part == "0") {
+      flags[i] = false;
+    } else if (part == "1") {
+      flags[i] = true;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::optional<BoardLocation> ParseEnpSquare(std::string_view enp) {
   size_t pos = enp.find(':');
-  if (pos == std::string::npos) {
+  if (pos == std::string_view::npos) {
     return std::nullopt;
   }
-  std::string to = enp.substr(pos + 1);
-  if (!to.empty() && to[to.size() - 1] == '\'') {
-    to = to.substr(0, to.size() - 1);
+  std::string_view to = enp.substr(pos + 1);
+  if (!to.empty() && to.back() == '\'') {
+    to.remove_suffix(1);
   }
   if (to.size() < 2 || to.size() > 3) {
     return std::nullopt;
@@ -102,10 +139,60 @@ std::optional<BoardLocation> ParseEnpLocation(const std::string& enp) {
   return BoardLocation(row, col);
 }
 
-std::shared_ptr<Board> ParseBoardFromFEN(const std::string& fen) {
-  std::vector<std::string> parts = SplitStr(fen, "-");
-  if (parts.size() < 7 || parts.size() > 8) {
-    return nullptr;  // invalid format
+bool ParsePlayerColor(char ch, PlayerColor& color) {
+  switch (ch) {
+  case 'r': case 'R':
+    color = RED;
+    return true;
+  case 'b': case 'B':
+    color = BLUE;
+    return true;
+  case 'y': case 'Y':
+    color = YELLOW;
+    return true;
+  case 'g': case 'G':
+    color = GREEN;
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool ParsePieceType(char ch, PieceType& piece_type) {
+  switch (ch) {
+  case 'P':
+    piece_type = PAWN;
+    return true;
+  case 'R':
+    piece_type = ROOK;
+    return true;
+  case 'N':
+    piece_type = KNIGHT;
+    return true;
+  case 'B':
+    piece_type = BISHOP;
+    return true;
+  case 'K':
+    piece_type = KING;
+    return true;
+  case 'Q':
+    piece_type = QUEEN;
+    return true;
+  default:
+    return false;
+  }
+}
+
+}  // namespace
+
+std::optional<BoardLocation> ParseEnpLocation(const std::string& enp) {
+  return ParseEnpSquare(enp);
+}
+
+bool ParseFEN(std::string_view fen, Board& board) {
+  size_t num_parts = CountChar(fen, '-') + 1;
+  if (num_parts < 7 || num_parts > 8) {
+    return false;  // invalid format
   }
 
   // Not used for teams chess: eliminated players, points
@@ -120,56 +207,36 @@ std::shared_ptr<Board> ParseBoardFromFEN(const std::string& fen) {
   // 6 (optional?): En-passant
   // 7: Piece placement
 
-  const auto& player_str = parts[0];
-  const auto& castling_availability_kingside = parts[2];
-  const auto& castling_availability_queenside = parts[3];
-  const auto& piece_placement = parts.back();
-
-  std::string enpassant;
-  if (parts.size() == 8) {
-    enpassant = parts[6];
+  std::string_view player_str = NextToken(fen, '-');
+  NextToken(fen, '-');
+  std::string_view castling_availability_kingside = NextToken(fen, '-');
+  std::string_view castling_availability_queenside = NextToken(fen, '-');
+  NextToken(fen, '-');
+  NextToken(fen, '-');
+  std::string_view enpassant;
+  if (num_parts == 8) {
+    enpassant = NextToken(fen, '-');
   }
+  std::string_view piece_placement = fen;
 
   // Parse player
-  if (player_str.size() != 1) {
-    return nullptr;  // invalid format
-  }
-  char pchar = player_str[0];
-  Player player;
-  switch (pchar) {
-  case 'R':
-    player = Player(RED);
-    break;
-  case 'B':
-    player = Player(BLUE);
-    break;
-  case 'Y':
-    player = Player(YELLOW);
-    break;
-  case 'G':
-    player = Player(GREEN);
-    break;
-  default:
-    return nullptr;  // invalid format
+  PlayerColor turn;
+  if (player_str.size() != 1
+      || !std::isupper(player_str[0])
+      || !ParsePlayerColor(player_str[0], turn)) {
+    return false;  // invalid format
   }
 
   // Parse castling availability
-  std::optional<std::vector<bool>> kingside = ParseCastlingAvailability(
-      castling_availability_kingside);
-  if (!kingside.has_value()) {
-    return nullptr;  // invalid format
-  }
-  std::optional<std::vector<bool>> queenside = ParseCastlingAvailability(
-      castling_availability_queenside);
-  if (!queenside.has_value()) {
-    return nullptr;  // invalid format
+  bool kingside[4];
+  bool queenside[4];
+  if (!ParseCastlingFlags(castling_availability_kingside, kingside)
+      || !ParseCastlingFlags(castling_availability_queenside, queenside)) {
+    return false;  // invalid format
   }
-
-  std::unordered_map<Player, CastlingRights> castling_rights;
-  for (int player_color = 0; player_color < 4; player_color++) {
-    Player pl(static_cast<PlayerColor>(player_color));
-    castling_rights[pl] = CastlingRights((*kingside)[player_color],
-                                         (*queenside)[player_color]);
+  CastlingRights castling_rights[4];
+  for (int color = 0; color < 4; color++) {
+    castling_rights[color] = CastlingRights(kingside[color], queenside[color]);
   }
 
   // Parse enpassant
@@ -177,17 +244,19 @@ std::shared_ptr<Board> ParseBoardFromFEN(const std::string& fen) {
   if (!enpassant.empty()) {
     size_t lbrace_pos = enpassant.find('(');
     size_t rbrace_pos = enpassant.rfind(')');
-    if (lbrace_pos == std::string::npos || rbrace_pos == std::string::npos) {
+    if (lbrace_pos == std::string_view::npos
+        || rbrace_pos == std::string_view::npos
+        || rbrace_pos < lbrace_pos) {
       // invalid enpassant string
-      return nullptr;
+      return false;
     }
-    auto parts = SplitStr(
-        enpassant.substr(lbrace_pos + 1, rbrace_pos - lbrace_pos), ",");
-    if (parts.size() != 4) { // invalid
-      return nullptr;
+    std::string_view moves = enpassant.substr(
+        lbrace_pos + 1, rbrace_pos - lbrace_pos - 1);
+    if (CountChar(moves, ',') != 3) { // invalid
+      return false;
     }
     for (int i = 0; i < 4; i++) {
-      auto enp_location = ParseEnpLocation(parts[i]);
+      auto enp_location = ParseEnpSquare(NextToken(moves, ','));
       if (enp_location.has_value()) {
         BoardLocation& to = *enp_location;
         int from_row = to.GetRow();
@@ -214,94 +283,66 @@ std::shared_ptr<Board> ParseBoardFromFEN(const std::string& fen) {
   }
 
   // Parse piece placement
-  std::vector<std::string> rows = SplitStr(piece_placement, "/");
-  if (rows.size() != 14) {
-    return nullptr;  // invalid format
-  }
-  std::unordered_map<BoardLocation, Piece> location_to_piece;
-  for (size_t row = 0; row < rows.size(); row++) {
-    std::vector<std::string> cols = SplitStr(rows[row], ",");
+  if (CountChar(piece_placement, '/') != 13) {
+    return false;  // invalid format
+  }
+  Piece pieces[14][14];
+  size_t num_pieces[4] = {0, 0, 0, 0};
+  for (int row = 0; row < 14; row++) {
+    std::string_view row_str = NextToken(piece_placement, '/');
+    if (row_str.empty() || row_str.back() == ',') {
+      return false;  // invalid format
+    }
     int col = 0;
-    for (const auto& col_str : cols) {
-
+    while (!row_str.empty()) {
+      std::string_view col_str = NextToken(row_str, ',');
       if (col_str.empty()) {
-        return nullptr;  // invalid format
+        return false;  // invalid format
       }
 
       char ch = col_str[0];
-      if (ch == 'r' || ch == 'b' || ch == 'y' || ch == 'g') {
+      PlayerColor player_color;
+      if (std::islower(ch) && ParsePlayerColor(ch, player_color)) {
         // Parse piece
-        if (col_str.size() != 2) {
-          return nullptr;  // invalid format
-        }
-        BoardLocation location(row, col);
-
-        PlayerColor player_color;
-        switch (ch) {
-        case 'r':
-          player_color = RED;
-          break;
-        case 'b':
-          player_color = BLUE;
-          break;
-        case 'y':
-          player_color = YELLOW;
-          break;
-        case 'g':
-          player_color = GREEN;
-          break;
-        default:
-          return nullptr;  // invalid format
-        }
-
         PieceType piece_type;
-        switch (col_str[1]) {
-        case 'P':
-          piece_type = PAWN;
-          break;
-        case 'R':
-          piece_type = ROOK;
-          break;
-        case 'N':
-          piece_type = KNIGHT;
-          break;
-        case 'B':
-          piece_type = BISHOP;
-          break;
-        case 'K':
-          piece_type = KING;
-          break;
-        case 'Q':
-          piece_type = QUEEN;
-          break;
-        default:
-          return nullptr;  // invalid format
+        if (col_str.size() != 2
+            || col >= 14
+            || !ParsePieceType(col_str[1], piece_type)
+            || ++num_pieces[player_color] > PieceList::kCapacity) {
+          return false;  // invalid format
         }
-
-        Player player(player_color);
-        Piece piece(player, piece_type);
-
-        location_to_piece[location] = piece;
-
+        pieces[row][col] = Piece(Player(player_color), piece_type);
         col++;
       } else if (ch == 'x') {
         // parse empty square
         col += 1;
       } else {
         // Parse empty spaces
-        std::optional<int> num_empty = ParseInt(col_str);
-        if (!num_empty.has_value() || *num_empty <= 0) {
-          return nullptr;  // invalid format
+        int num_empty = 0;
+        auto [end, ec] = std::from_chars(
+            col_str.data(), col_str.data() + col_str.size(), num_empty);
+        if (ec != std::errc() || num_empty <= 0 || num_empty > 14) {
+          return false;  // invalid format
         }
-        col += *num_empty;
+        col += num_empty;
+      }
+      if (col > 14) {
+        return false;  // row too long
       }
-
     }
   }
 
-  return std::make_shared<Board>(
-      std::move(player), std::move(location_to_piece),
-      std::move(castling_rights), std::move(enp));
+  board.SetPosition(Player(turn), pieces, castling_rights, enp);
+  return true;
+}
+
+std::shared_ptr<Board> ParseBoardFromFEN(const std::string& fen) {
+  auto board = std::make_shared<Board>(
+      Player(RED), std::unordered_map<BoardLocation, Piece>());
+  if (!ParseFEN(fen, *board)) {
+    return nullptr;
+  }
+  return board;
 }
 
 void SendInfoMessage(const std::string& message) {
@@ -411,7 +452,7 @@ std::optional<Move> ParseMove(Board& board, const std::string& move_str_ref) {
   PieceType promotion_piece_type = std::get<1>(*promotion);
 
   Move moves[300];
-  size_t num_moves = board.GetPseudoLegalMoves2(moves, 300);
+  size_t num_moves = board.GetLegalMoves(moves, 300);
 
   for (size_t i = 0; i < num_moves; i++) {
     const auto& move = moves[i];
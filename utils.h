@@ -5,6 +5,7 @@
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "board.h"
@@ -23,6 +24,11 @@ std::optional<std::vector<bool>> ParseCastlingAvailability(
 
 std::shared_ptr<Board> ParseBoardFromFEN(const std::string& fen);
 
+// Sets up `board` from the FEN in place without allocating, keeping its
+// options (see Board::SetPosition). Returns false and leaves the board
+// unchanged if the FEN is invalid.
+bool ParseFEN(std::string_view fen, Board& board);
+
 void SendInfoMessage(const std::string& message);
 
 void SendInvalidCommandMessage(const std::string& line);
@@ -41,6 +41,73 @@ TEST(UtilsTest, ParseFENWithError2) {
   EXPECT_TRUE(res.has_value());
 }
 
+TEST(UtilsTest, ParseFENInPlace) {
+  constexpr char kFEN[] = "R-0,0,0,0-1,1,1,1-1,1,1,0-0,0,0,0-0-x,x,x,yR,yN,yB,1,yK,yB,1,yR,x,x,x/x,x,x,1,yP,1,yP,1,yP,yP,1,x,x,x/x,x,x,2,yP,1,yP,yN,2,x,x,x/bR,bP,1,yP,6,yP,1,gP,1/1,bP,11,gR/bB,10,gP,gP,gB/1,bP,2,bN,7,gP,1/bK,1,bP,8,gP,1,gK/bB,bP,10,gP,gB/bN,bP,bQ,7,rP,1,gP,gN/bR,bP,4,rQ,6,gR/x,x,x,2,rP,2,gP,2,x,x,x/x,x,x,rP,rP,1,rP,rP,rP,1,rP,x,x,x/x,x,x,rR,rN,rB,1,rK,rB,1,rR,x,x,x";
+  auto expected = ParseBoardFromFEN(kFEN);
+  ASSERT_NE(nullptr, expected);
+
+  // Reuse a board that has moves on it and attack maps enabled.
+  auto board = Board::CreateStandardSetup();
+  board->EnableAttackMaps(true);
+  board->MakeMove(Move(BoardLocation(12, 7), BoardLocation(10, 7)));
+  ASSERT_TRUE(ParseFEN(kFEN, *board));
+
+  EXPECT_EQ(0, board->NumMoves());
+  EXPECT_EQ(expected->GetTurn(), board->GetTurn());
+  EXPECT_EQ(expected->HashKey(), board->HashKey());
+  EXPECT_EQ(expected->PawnKey(), board->PawnKey());
+  EXPECT_EQ(expected->PieceEvaluation(), board->PieceEvaluation());
+  EXPECT_EQ(expected->GetOccupied(), board->GetOccupied());
+  for (int color = 0; color < 4; color++) {
+    Player player(static_cast<PlayerColor>(color));
+    EXPECT_EQ(expected->GetCastlingRights(player),
+              board->GetCastlingRights(player));
+  }
+  for (int row = 0; row < 14; row++) {
+    for (int col = 0; col < 14; col++) {
+      BoardLocation location(row, col);
+      EXPECT_EQ(expected->GetPiece(location), board->GetPiece(location));
+      if (board->IsLegalLocation(location)) {
+        EXPECT_EQ(expected->IsAttackedByTeam(RED_YELLOW, location),
+                  board->GetAttackCount(RED_YELLOW, location) > 0);
+      }
+    }
+  }
+
+  Move moves[300];
+  size_t num_moves = board->GetLegalMoves(moves, 300);
+  Move expected_moves[300];
+  EXPECT_EQ(expected->GetLegalMoves(expected_moves, 300), num_moves);
+
+  // An invalid FEN leaves the board alone.
+  int64_t hash_key = board->HashKey();
+  EXPECT_FALSE(ParseFEN("R-0,0,0,0-1,1,1,1", *board));
+  EXPECT_FALSE(ParseFEN(std::string(kFEN) + ",rQ", *board));
+  // A row of empty squares that runs past the board.
+  std::string header = "R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-";
+  std::string empty_rows;
+  for (int row = 1; row < 14; row++) {
+    empty_rows += "/14";
+  }
+  EXPECT_FALSE(ParseFEN(header + "20" + empty_rows, *board));
+  // More pieces of one color than a piece list holds.
+  std::string pawn_row = "rP";
+  for (int col = 1; col < 14; col++) {
+    pawn_row += ",rP";
+  }
+  std::string pawn_fen = header + "14/14/14";
+  for (int row = 3; row < 14; row++) {
+    pawn_fen += "/" + (row < 6 ? pawn_row : "14");
+  }
+  EXPECT_FALSE(ParseFEN(pawn_fen, *board));
+  EXPECT_EQ(hash_key, board->HashKey());
+
+  // The last en-passant entry is read too.
+  ASSERT_TRUE(ParseFEN("R-0,0,0,0-1,1,1,1-1,1,1,1-0,0,0,0-0-{'enPassant':('','','','l5:k5')}-x,x,x,yR,yN,yB,yK,yQ,yB,yN,yR,x,x,x/x,x,x,yP,yP,yP,yP,yP,yP,yP,yP,x,x,x/x,x,x,8,x,x,x/bR,bP,10,gP,gR/bN,bP,10,gP,gN/bB,bP,10,gP,gB/bQ,bP,10,gP,gK/bK,bP,10,gP,gQ/bB,bP,10,gP,gB/bN,bP,8,gP,2,gN/bR,bP,10,gP,gR/x,x,x,8,x,x,x/x,x,x,rP,rP,rP,rP,rP,rP,rP,rP,x,x,x/x,x,x,rR,rN,rB,rQ,rK,rB,rN,rR,x,x,x", *board));
+  EXPECT_EQ(board->GetEnpassantInitialization().enp_moves[GREEN],
+            Move(BoardLocation(9, 12), BoardLocation(9, 10)));
+}
+
 TEST(UtilsTest, ParseEnpLocation) {
   auto enp_location = ParseEnpLocation("c4:d4");
   EXPECT_EQ(enp_location, BoardLocation(10, 3));